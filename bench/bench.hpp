@@ -0,0 +1,69 @@
+
+#pragma once
+
+#include <time.h>
+
+#include "shl/number_types.hpp"
+#include "shl/streams.hpp"
+
+struct bench_input
+{
+    const char *path;
+    memory_stream data;
+    u64 word_count;
+    u64 instruction_count;
+};
+
+// sets word_count and instruction_count of input from its data
+void bench_count_instructions(bench_input *input);
+
+inline u64 bench_time_ns()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000ull + (u64)ts.tv_nsec;
+}
+
+// results are written here so the compiler cannot drop benchmarked work
+inline volatile u64 bench_sink = 0;
+
+// runs FUNC N times and stores the average nanoseconds per run in OUT_NS.
+#define bench_run(OUT_NS, N, FUNC)\
+    {\
+        u64 _bench_start = bench_time_ns();\
+        for (u64 _bench_i = 0; _bench_i < (N); ++_bench_i)\
+            FUNC;\
+        OUT_NS = (bench_time_ns() - _bench_start) / (N);\
+    }
+
+// number of malloc, calloc and realloc calls of the process so far, or -1
+// if they cannot be counted (only glibc allocations are intercepted).
+s64 bench_allocation_count();
+
+// runs FUNC once and stores the number of allocations it made in OUT.
+#define bench_count_allocations(OUT, FUNC)\
+    {\
+        s64 _bench_allocs = bench_allocation_count();\
+        FUNC;\
+        OUT = _bench_allocs < 0 ? -1 : bench_allocation_count() - _bench_allocs;\
+    }
+
+// prints ns/word, instructions/s and allocations of one benchmark below
+// its result line (unless print is false) and keeps it for bench_write_json.
+void bench_record(const bench_input *input, const char *name, u64 ns, s64 allocations, bool print = true);
+// writes every recorded result to path as JSON
+bool bench_write_json(const char *path, u64 iterations);
+
+void bench_parse(bench_input *input, u64 iterations);
+void bench_reflect(bench_input *input, u64 iterations);
+// input->path must be a file
+void bench_load(bench_input *input, u64 iterations);
+void bench_batch(u32 module_count, u64 iterations);
+void bench_merge(u32 module_count, u32 uniform_blocks, u64 iterations);
+void bench_registry(u32 pipeline_count, u64 iterations);
+// cache directory: SPIRV_BENCH_CACHE_DIR, default /tmp/spirv-parser-bench-cache
+void bench_cache(bench_input *input, u64 iterations);
+// byteswap throughput per isa, parse of a byte-reversed module
+void bench_swap(bench_input *input, u64 iterations);
+// synthetic modules growing along one dimension at a time, up to 10^6 ids
+void bench_scaling(u64 iterations);
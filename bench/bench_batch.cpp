@@ -0,0 +1,69 @@
+#include <stdio.h>
+#include <thread>
+
+#include "shl/defer.hpp"
+#include "spirv_batch.hpp"
+#include "bench.hpp"
+#include "bench_module.hpp"
+
+// parses module_count synthetic modules of varying size with 1, 2, 4, ...
+// threads up to the hardware thread count.
+void bench_batch(u32 module_count, u64 iterations)
+{
+    array<spirv_batch_input> inputs{};
+    ::resize(&inputs, module_count);
+
+    defer
+    {
+        for_array(input, &inputs)
+            ::close(&input->data);
+
+        ::free(&inputs);
+    };
+
+    u64 total_bytes = 0;
+
+    for_array(i, input, &inputs)
+    {
+        // sizes vary so the initial split is uneven and stealing matters
+        bench_module_params params{};
+        params.constants = 200 + (u32)(i % 7) * 400;
+        params.uniform_blocks = 10 + (u32)(i % 5) * 40;
+        params.call_depth = (u32)(i % 3);
+
+        ::fill_memory(input, 0);
+        build_bench_module(&params, &input->data);
+        total_bytes += input->data.size;
+    }
+
+    u32 hardware_threads = std::thread::hardware_concurrency();
+
+    if (hardware_threads == 0)
+        hardware_threads = 1;
+
+    printf("batch of %u synthetic modules (%lu bytes), %u hardware threads\n", module_count, total_bytes, hardware_threads);
+
+    u64 single_ns = 0;
+
+    for (u32 threads = 1; threads <= hardware_threads; threads = threads * 2 > hardware_threads && threads != hardware_threads ? hardware_threads : threads * 2)
+    {
+        spirv_batch_options options{};
+        init(&options);
+        options.thread_count = threads;
+
+        u64 ns = 0;
+
+        bench_run(ns, iterations,
+        {
+            array<spirv_batch_result> results{};
+            parse_spirv_batch(inputs.data, inputs.size, &results, &options);
+            bench_sink = bench_sink + results.size;
+            ::free<true>(&results);
+        });
+
+        if (threads == 1)
+            single_ns = ns;
+
+        printf("  %2u threads               %8lu ns, %.2fx\n", threads, ns, (double)single_ns / (double)ns);
+    }
+}
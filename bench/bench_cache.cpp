@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "spirv_cache.hpp"
+#include "spirv_blob.hpp"
+#include "bench.hpp"
+
+static const char *_cache_directory()
+{
+    if (const char *dir = getenv("SPIRV_BENCH_CACHE_DIR"))
+        return dir;
+
+    return "/tmp/spirv-parser-bench-cache";
+}
+
+static bool _reflect_cached(spirv_reflection_cache *cache, memory_stream data)
+{
+    spirv_pipeline_info pinfo{};
+    init(&pinfo);
+
+    bool hit = false;
+
+    if (!get_pipeline_info_cached(cache, &data, &pinfo, nullptr, nullptr, &hit))
+        printf("  parse failed\n");
+
+    free(&pinfo);
+
+    return hit;
+}
+
+// what startup does with a reflection blob: open it and hand out the
+// bindings of every set. path is mapped, or data is used if path is nullptr.
+static u64 _open_blob_once(const char *path, const memory_stream *data)
+{
+    spirv_blob blob{};
+    init(&blob);
+
+    if (path != nullptr ? !open_spirv_blob_file(&blob, path, nullptr)
+                        : !open_spirv_blob(&blob, data->data, data->size, nullptr))
+        printf("  could not open blob\n");
+
+    u64 bindings = 0;
+
+    for (u32 set = 0; blob.header != nullptr && set < blob.header->descriptor_set_count; ++set)
+    {
+        u32 count = 0;
+        get_set_bindings(&blob, set, &count);
+        bindings += count;
+    }
+
+    free(&blob);
+
+    return bindings;
+}
+
+static void _bench_blob(bench_input *input, u64 iterations)
+{
+    spirv_info info{};
+    init(&info);
+
+    memory_stream data = input->data;
+
+    if (!parse_spirv_from_memory(&data, &info, nullptr))
+        return;
+
+    spirv_pipeline_info pinfo{};
+    init(&pinfo);
+    get_pipeline_info(&pinfo, &info);
+
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/bench.sprb", _cache_directory());
+
+    error err{};
+    memory_stream blob{};
+
+    if (!write_spirv_blob(&info, &pinfo, &blob, &err) || !write_spirv_blob_file(path, &info, &pinfo, &err))
+        printf("  could not write blob: %s\n", err.what);
+    else
+    {
+        u64 ns = 0;
+        s64 allocs = 0;
+
+        bench_count_allocations(allocs, _open_blob_once(nullptr, &blob));
+        bench_run(ns, iterations, bench_sink = bench_sink + _open_blob_once(nullptr, &blob));
+
+        printf("  open_spirv_blob          %8lu ns, %lu bytes\n", ns, blob.size);
+        bench_record(input, "open_spirv_blob", ns, allocs);
+
+        bench_count_allocations(allocs, _open_blob_once(path, nullptr));
+        bench_run(ns, iterations, bench_sink = bench_sink + _open_blob_once(path, nullptr));
+
+        printf("  open_spirv_blob_file     %8lu ns, mapped\n", ns);
+        bench_record(input, "open_spirv_blob_file", ns, allocs);
+    }
+
+    ::close(&blob);
+
+    free(&pinfo);
+    free(&info);
+}
+
+void bench_cache(bench_input *input, u64 iterations)
+{
+    spirv_reflection_cache cache{};
+    init(&cache, _cache_directory());
+
+    u64 hash_ns = 0;
+    u64 warm_ns = 0;
+
+    // make sure the entry exists
+    _reflect_cached(&cache, input->data);
+
+    bool hit = false;
+
+    bench_run(hash_ns, iterations, bench_sink = bench_sink + hash_spirv_module(input->data.data, input->data.size));
+    bench_run(warm_ns, iterations, hit = _reflect_cached(&cache, input->data));
+
+    printf("  hash_spirv_module        %8lu ns, %.2f GB/s\n", hash_ns, (double)input->data.size / (double)(hash_ns ? hash_ns : 1));
+    printf("  cached pipeline info     %8lu ns, %s\n", warm_ns, hit ? "hit" : "miss");
+
+    _bench_blob(input, iterations);
+}
@@ -0,0 +1,38 @@
+#include <stdio.h>
+
+#include "spirv_parser.hpp"
+#include "bench.hpp"
+
+// returns the number of input bytes the info keeps on the heap
+static u64 _load_once(const char *path, bool use_mmap)
+{
+    spirv_parse_options options{};
+    init(&options);
+    options.use_mmap = use_mmap;
+
+    spirv_info info{};
+    init(&info);
+
+    if (!parse_spirv_from_file(path, &info, nullptr, &options))
+        printf("  parse failed\n");
+
+    u64 heap_bytes = info.mapping.data != nullptr ? 0 : info.data.size;
+
+    free(&info);
+
+    return heap_bytes;
+}
+
+void bench_load(bench_input *input, u64 iterations)
+{
+    u64 read_ns = 0;
+    u64 mmap_ns = 0;
+    u64 read_bytes = 0;
+    u64 mmap_bytes = 0;
+
+    bench_run(read_ns, iterations, read_bytes = _load_once(input->path, false));
+    bench_run(mmap_ns, iterations, mmap_bytes = _load_once(input->path, true));
+
+    printf("  parse_spirv_from_file    %8lu ns, %lu heap input bytes\n", read_ns, read_bytes);
+    printf("  parse_spirv_from_file, mmap %5lu ns, %lu heap input bytes\n", mmap_ns, mmap_bytes);
+}
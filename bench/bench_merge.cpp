@@ -0,0 +1,57 @@
+#include <stdio.h>
+
+#include "spirv_parser.hpp"
+#include "bench.hpp"
+#include "bench_module.hpp"
+
+// merges the pipeline info of module_count parsed modules that all use
+// the same uniform_blocks bindings, like the stages of one pipeline.
+void bench_merge(u32 module_count, u32 uniform_blocks, u64 iterations)
+{
+    array<memory_stream> modules{};
+    array<spirv_info> infos{};
+    array<spirv_info*> info_ptrs{};
+
+    ::resize(&modules, module_count);
+    ::resize(&infos, module_count);
+    ::resize(&info_ptrs, module_count);
+
+    for (u32 i = 0; i < module_count; ++i)
+    {
+        bench_module_params params{};
+        params.constants = 16;
+        params.uniform_blocks = uniform_blocks;
+
+        build_bench_module(&params, modules.data + i);
+
+        init(infos.data + i);
+        info_ptrs[i] = infos.data + i;
+
+        memory_stream data = modules[i];
+        parse_spirv_from_memory(&data, infos.data + i, nullptr);
+    }
+
+    u64 ns = 0;
+
+    bench_run(ns, iterations,
+    {
+        spirv_pipeline_info pinfo{};
+        init(&pinfo);
+        get_pipeline_info(&pinfo, info_ptrs.data, info_ptrs.size, nullptr);
+        bench_sink = bench_sink + pinfo.descriptor_sets.size;
+        free(&pinfo);
+    });
+
+    printf("merge of %u modules with %u bindings each\n", module_count, uniform_blocks);
+    printf("  get_pipeline_info        %8lu ns, %.2f ns/binding\n", ns, (double)ns / (double)(module_count * uniform_blocks));
+
+    for (u32 i = 0; i < module_count; ++i)
+    {
+        free(infos.data + i);
+        ::close(modules.data + i);
+    }
+
+    ::free(&modules);
+    ::free(&infos);
+    ::free(&info_ptrs);
+}
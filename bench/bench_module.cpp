@@ -0,0 +1,272 @@
+
+#include "shl/string.hpp"
+#include "spirv1_2.h"
+#include "bench_module.hpp"
+
+#define HEADER_WORDS 5
+
+void init(bench_module_builder *b)
+{
+    ::init(&b->words);
+    b->bound = 1;
+
+    // header, filled in by finish
+    for (u32 i = 0; i < HEADER_WORDS; ++i)
+        ::add_at_end(&b->words, 0u);
+}
+
+void free(bench_module_builder *b)
+{
+    ::free(&b->words);
+}
+
+u32 add_id(bench_module_builder *b)
+{
+    return b->bound++;
+}
+
+void emit(bench_module_builder *b, u16 opcode, const u32 *operands, u32 operand_count)
+{
+    emit(b, opcode, operands, operand_count, nullptr, nullptr, 0);
+}
+
+void emit(bench_module_builder *b, u16 opcode, const u32 *operands, u32 operand_count, const char *str, const u32 *trailing, u32 trailing_count)
+{
+    u32 str_words = 0;
+
+    if (str != nullptr)
+        str_words = (u32)(string_length(str) / 4) + 1;
+
+    u32 word_count = 1 + operand_count + str_words + trailing_count;
+    ::add_at_end(&b->words, (word_count << 16) | opcode);
+
+    for (u32 i = 0; i < operand_count; ++i)
+        ::add_at_end(&b->words, operands[i]);
+
+    if (str != nullptr)
+    {
+        u64 at = b->words.size;
+        ::reserve(&b->words, at + str_words);
+        ::fill_memory(b->words.data + at, 0, str_words);
+        ::copy_memory(str, b->words.data + at, string_length(str));
+        b->words.size += str_words;
+    }
+
+    for (u32 i = 0; i < trailing_count; ++i)
+        ::add_at_end(&b->words, trailing[i]);
+}
+
+void finish(bench_module_builder *b, memory_stream *out)
+{
+    b->words[0] = SpvMagicNumber;
+    if (b->words[1] == 0)
+        b->words[1] = 0x00010000;
+    b->words[2] = 0;
+    b->words[3] = b->bound;
+    b->words[4] = 0;
+
+    u64 size = b->words.size * sizeof(u32);
+    ::open(out, size);
+    ::copy_memory(b->words.data, out->data, size);
+}
+
+static void _emit_block_accesses(bench_module_builder *b, const bench_module_params *params, u32 first_block, u32 float_ptr_id, u32 float_id, u32 zero_id)
+{
+    for (u32 i = 0; i < params->uniform_blocks; ++i)
+    {
+        u32 var_id = first_block + i * 3 + 2;
+        u32 chain_id = add_id(b);
+        u32 load_id = add_id(b);
+
+        bench_emit(b, SpvOpAccessChain, float_ptr_id, chain_id, var_id, zero_id);
+        bench_emit(b, SpvOpLoad, float_id, load_id, chain_id);
+    }
+}
+
+void build_bench_module(const bench_module_params *params, memory_stream *out)
+{
+    bench_module_builder _b{};
+    bench_module_builder *b = &_b;
+    init(b);
+
+    u32 main_id = add_id(b);
+    u32 void_id = add_id(b);
+    u32 fn_type_id = add_id(b);
+    u32 float_id = add_id(b);
+    u32 uint_id = add_id(b);
+    u32 vec4_id = add_id(b);
+    u32 float_ptr_id = add_id(b);
+    u32 zero_id = add_id(b);
+    u32 uvec3_id = add_id(b);
+    u32 uvec3_ptr_id = add_id(b);
+    u32 invocation_id = add_id(b);
+
+    u32 first_block = b->bound;
+    b->bound += params->uniform_blocks * 3; // struct, pointer, variable
+
+    // S0 { vec4 }, Sn { float, Sn-1 }
+    u32 first_nested = b->bound;
+    b->bound += params->struct_depth;
+
+    u32 first_function = b->bound;
+    b->bound += params->functions;
+
+    bench_emit(b, SpvOpCapability, SpvCapabilityShader);
+    bench_emit(b, SpvOpMemoryModel, SpvAddressingModelLogical, SpvMemoryModelGLSL450);
+
+    {
+        array<u32> interface{};
+        ::add_at_end(&interface, invocation_id);
+
+        if (params->version >= 0x00010400)
+        for (u32 i = 0; i < params->uniform_blocks; ++i)
+            ::add_at_end(&interface, first_block + i * 3 + 2);
+
+        const u32 ops[] = {SpvExecutionModelGLCompute, main_id};
+        emit(b, SpvOpEntryPoint, ops, 2, "main", interface.data, (u32)interface.size);
+        ::free(&interface);
+    }
+
+    bench_emit(b, SpvOpExecutionMode, main_id, SpvExecutionModeLocalSize, 1, 1, 1);
+
+    emit(b, SpvOpName, &main_id, 1, "main", nullptr, 0);
+
+    bench_emit(b, SpvOpDecorate, invocation_id, SpvDecorationBuiltIn, SpvBuiltInGlobalInvocationId);
+
+    for (u32 i = 0; i < params->uniform_blocks; ++i)
+    {
+        u32 struct_id = first_block + i * 3;
+        u32 var_id = struct_id + 2;
+
+        bench_emit(b, SpvOpDecorate, struct_id, SpvDecorationBlock);
+        bench_emit(b, SpvOpMemberDecorate, struct_id, 0, SpvDecorationOffset, 0);
+        bench_emit(b, SpvOpMemberDecorate, struct_id, 1, SpvDecorationOffset, 16);
+        bench_emit(b, SpvOpDecorate, var_id, SpvDecorationDescriptorSet, i / 16);
+        bench_emit(b, SpvOpDecorate, var_id, SpvDecorationBinding, i % 16);
+    }
+
+    for (u32 i = 0; i < params->struct_depth; ++i)
+    {
+        bench_emit(b, SpvOpMemberDecorate, first_nested + i, 0, SpvDecorationOffset, 0);
+
+        if (i > 0)
+            bench_emit(b, SpvOpMemberDecorate, first_nested + i, 1, SpvDecorationOffset, 16);
+    }
+
+    bench_emit(b, SpvOpTypeVoid, void_id);
+    bench_emit(b, SpvOpTypeFunction, fn_type_id, void_id);
+    bench_emit(b, SpvOpTypeFloat, float_id, 32);
+    bench_emit(b, SpvOpTypeInt, uint_id, 32, 0);
+    bench_emit(b, SpvOpTypeVector, vec4_id, float_id, 4);
+    bench_emit(b, SpvOpTypePointer, float_ptr_id, SpvStorageClassUniform, float_id);
+    bench_emit(b, SpvOpTypeVector, uvec3_id, uint_id, 3);
+    bench_emit(b, SpvOpTypePointer, uvec3_ptr_id, SpvStorageClassInput, uvec3_id);
+    bench_emit(b, SpvOpVariable, uvec3_ptr_id, invocation_id, SpvStorageClassInput);
+    bench_emit(b, SpvOpConstant, uint_id, zero_id, 0);
+
+    for (u32 i = 0; i < params->constants; ++i)
+    {
+        u32 const_id = add_id(b);
+        bench_emit(b, SpvOpConstant, uint_id, const_id, i + 1);
+    }
+
+    u32 block_member_id = vec4_id;
+
+    for (u32 i = 0; i < params->struct_depth; ++i)
+    {
+        if (i == 0)
+        {
+            bench_emit(b, SpvOpTypeStruct, first_nested, vec4_id);
+        }
+        else
+        {
+            bench_emit(b, SpvOpTypeStruct, first_nested + i, float_id, first_nested + i - 1);
+        }
+
+        block_member_id = first_nested + i;
+    }
+
+    for (u32 i = 0; i < params->uniform_blocks; ++i)
+    {
+        u32 struct_id = first_block + i * 3;
+        u32 ptr_id = struct_id + 1;
+        u32 var_id = struct_id + 2;
+
+        bench_emit(b, SpvOpTypeStruct, struct_id, float_id, block_member_id);
+        bench_emit(b, SpvOpTypePointer, ptr_id, SpvStorageClassUniform, struct_id);
+        bench_emit(b, SpvOpVariable, ptr_id, var_id, SpvStorageClassUniform);
+    }
+
+    // main, the call chain and finally the function accessing the blocks
+    u32 chain_length = params->call_depth + 1;
+
+    u32 function_id = main_id;
+
+    for (u32 f = 0; f < chain_length; ++f)
+    {
+        bench_emit(b, SpvOpFunction, void_id, function_id, SpvFunctionControlMaskNone, fn_type_id);
+        bench_emit(b, SpvOpLabel, add_id(b));
+
+        if (f == 0)
+        for (u32 i = 0; i < params->functions; ++i)
+            bench_emit(b, SpvOpFunctionCall, void_id, add_id(b), first_function + i);
+
+        if (f + 1 < chain_length)
+        {
+            u32 callee_id = add_id(b);
+            u32 result_id = add_id(b);
+            bench_emit(b, SpvOpFunctionCall, void_id, result_id, callee_id);
+            bench_emit(b, SpvOpReturn);
+            bench_emit(b, SpvOpFunctionEnd);
+
+            function_id = callee_id;
+            continue;
+        }
+
+        _emit_block_accesses(b, params, first_block, float_ptr_id, float_id, zero_id);
+
+        bench_emit(b, SpvOpReturn);
+        bench_emit(b, SpvOpFunctionEnd);
+    }
+
+    if (params->call_depth > 0)
+    {
+        bench_emit(b, SpvOpFunction, void_id, add_id(b), SpvFunctionControlMaskNone, fn_type_id);
+        bench_emit(b, SpvOpLabel, add_id(b));
+        _emit_block_accesses(b, params, first_block, float_ptr_id, float_id, zero_id);
+        bench_emit(b, SpvOpReturn);
+        bench_emit(b, SpvOpFunctionEnd);
+    }
+
+    for (u32 i = 0; i < params->functions; ++i)
+    {
+        bench_emit(b, SpvOpFunction, void_id, first_function + i, SpvFunctionControlMaskNone, fn_type_id);
+        bench_emit(b, SpvOpLabel, add_id(b));
+
+        if (params->uniform_blocks > 0)
+        {
+            u32 var_id = first_block + (i % params->uniform_blocks) * 3 + 2;
+            u32 chain_id = add_id(b);
+            bench_emit(b, SpvOpAccessChain, float_ptr_id, chain_id, var_id, zero_id);
+            bench_emit(b, SpvOpLoad, float_id, add_id(b), chain_id);
+        }
+
+        u32 value_id = zero_id;
+
+        for (u32 j = 0; j < params->function_size; ++j)
+        {
+            u32 sum_id = add_id(b);
+            bench_emit(b, SpvOpIAdd, uint_id, sum_id, value_id, zero_id);
+            value_id = sum_id;
+        }
+
+        bench_emit(b, SpvOpReturn);
+        bench_emit(b, SpvOpFunctionEnd);
+    }
+
+    if (params->version != 0)
+        b->words[1] = params->version;
+
+    finish(b, out);
+    free(b);
+}
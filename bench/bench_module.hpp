@@ -0,0 +1,56 @@
+
+#pragma once
+
+#include "shl/array.hpp"
+#include "shl/streams.hpp"
+
+// builds synthetic SPIR-V modules to measure how the parser scales.
+struct bench_module_params
+{
+    u32 constants; // plain OpConstants, mostly to grow the bound
+    u32 uniform_blocks; // struct + pointer + decorated uniform variable each
+
+    // if not 0, the uniform blocks are accessed at the end of a chain of
+    // call_depth functions called from main instead of in main.
+    // an extra function that no entry point calls also accesses them.
+    u32 call_depth;
+
+    // SPIR-V version in the header, 0 is 1.0. since 1.4 the entry point
+    // interface also lists the uniform blocks.
+    u32 version;
+
+    // if not 0, the second member of every uniform block is a chain of
+    // struct_depth nested structs (shared by all blocks) instead of a vec4.
+    u32 struct_depth;
+
+    // additional functions, each called from main. every function loads
+    // one of the uniform blocks and runs function_size OpIAdds.
+    u32 functions;
+    u32 function_size;
+};
+
+struct bench_module_builder
+{
+    array<u32> words;
+    u32 bound;
+};
+
+void init(bench_module_builder *b);
+void free(bench_module_builder *b);
+
+u32 add_id(bench_module_builder *b);
+void emit(bench_module_builder *b, u16 opcode, const u32 *operands, u32 operand_count);
+// emits operands, then the string, then trailing operands
+void emit(bench_module_builder *b, u16 opcode, const u32 *operands, u32 operand_count, const char *str, const u32 *trailing, u32 trailing_count);
+
+#define bench_emit(B, OP, ...)\
+    {\
+        const u32 _ops[] = {__VA_ARGS__};\
+        emit(B, OP, _ops, sizeof(_ops) / sizeof(u32));\
+    }
+
+// writes the finished module including the header into out.
+// out must be closed by the caller.
+void finish(bench_module_builder *b, memory_stream *out);
+
+void build_bench_module(const bench_module_params *params, memory_stream *out);
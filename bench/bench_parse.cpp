@@ -0,0 +1,289 @@
+
+#include <stdio.h>
+
+#include "shl/array.hpp"
+#include "spirv_parser.hpp"
+#include "bench.hpp"
+
+// returns the number of arena blocks if use_arena is set
+static u64 _parse_once(memory_stream data, bool use_arena, bool validate = false)
+{
+    spirv_parse_options options{};
+    init(&options);
+    options.use_arena = use_arena;
+    options.validate = validate;
+
+    spirv_info info{};
+    init(&info);
+
+    if (!parse_spirv_from_memory(&data, &info, nullptr, &options))
+        printf("  parse failed\n");
+
+    u64 blocks = info.arena.block_count;
+
+    free(&info);
+
+    return blocks;
+}
+
+// what the parser did before parsing sections: collect every instruction
+// header into a temporary array.
+static u64 _walk_materialized(memory_stream data)
+{
+    array<spirv_instruction> instructions{};
+
+    data.position = 5 * sizeof(u32);
+
+    while (!::is_at_end(&data))
+    {
+        spirv_instruction instr{};
+
+        instr.words = (u32*)::current(&data);
+        read(&data, &instr.opcode);
+        read(&data, &instr.word_count);
+
+        data.position += sizeof(u32) * (instr.word_count - 1);
+        ::add_at_end(&instructions, instr);
+    }
+
+    u64 bytes = instructions.reserved_size * sizeof(spirv_instruction);
+    ::free(&instructions);
+    return bytes;
+}
+
+// what the parser does now: one forward cursor, nothing is stored.
+static u64 _walk_streaming(memory_stream data)
+{
+    u64 count = 0;
+    data.position = 5 * sizeof(u32);
+
+    while (!::is_at_end(&data))
+    {
+        u16 word_count;
+        read_at(&data, &word_count, data.position + sizeof(u16));
+        data.position += sizeof(u32) * word_count;
+        count++;
+    }
+
+    return count;
+}
+
+// bytes of the id table and the per-id decoration index of one parse
+static void _print_id_table_size(memory_stream data)
+{
+    spirv_info info{};
+    init(&info);
+
+    if (!parse_spirv_from_memory(&data, &info, nullptr))
+        return;
+
+    u64 bound = info.ids.opcodes.size;
+    u64 table_bytes = bound * spirv_id_table_bytes_per_id;
+    u64 index_bytes = (info.decoration_offsets.size + info.decoration_indices.size) * sizeof(u32);
+
+    printf("  id table                 %8lu bytes for %lu ids, decoration index %lu bytes\n", table_bytes, bound, index_bytes);
+
+    free(&info);
+}
+
+// live bytes of the info after one parse and the peak during it
+static void _print_memory_usage(memory_stream data, bool use_arena)
+{
+    spirv_parse_options options{};
+    init(&options);
+    options.use_arena = use_arena;
+
+    spirv_info info{};
+    init(&info);
+
+    if (!parse_spirv_from_memory(&data, &info, nullptr, &options))
+        return;
+
+    spirv_info_memory_usage usage{};
+    get_memory_usage(&info, &usage);
+
+    spirv_pipeline_info pinfo{};
+    init(&pinfo);
+    get_pipeline_info(&pinfo, &info);
+
+    printf("  memory, %-5s %14lu bytes live, %lu peak during parse, %lu pipeline info\n",
+           use_arena ? "arena" : "heap", usage.total, usage.parse_peak, get_memory_usage(&pinfo));
+    printf("    id table %lu, decorations %lu, entry points %lu, types %lu, variables %lu, functions %lu, module %lu, arena overhead %lu\n",
+           usage.id_table, usage.decorations, usage.entry_points, usage.types, usage.variables, usage.functions, usage.data, usage.arena_overhead);
+
+    free(&pinfo);
+    free(&info);
+}
+
+// average per-phase statistics of iterations parses
+static void _print_parse_phases(bench_input *input, u64 iterations)
+{
+    spirv_parse_stats total{};
+    spirv_parse_stats stats{};
+
+    spirv_parse_options options{};
+    init(&options);
+    options.stats = &stats;
+
+    for (u64 i = 0; i < iterations; ++i)
+    {
+        memory_stream data = input->data;
+        spirv_info info{};
+        init(&info);
+
+        if (!parse_spirv_from_memory(&data, &info, nullptr, &options))
+            printf("  parse failed\n");
+
+        free(&info);
+
+        total.total_ns += stats.total_ns;
+
+        for (u32 p = 0; p < spirv_parse_phase_count; ++p)
+            total.phases[p].ns += stats.phases[p].ns;
+    }
+
+    // names are kept by bench_record, they are the same for every input
+    static char names[spirv_parse_phase_count][48];
+
+    printf("  phases of parse_spirv_from_memory, %lu ns total\n", total.total_ns / iterations);
+
+    for (u32 p = 0; p < spirv_parse_phase_count; ++p)
+    {
+        spirv_parse_phase_stats *phase = stats.phases + p;
+        u64 ns = total.phases[p].ns / iterations;
+
+        printf("    %-22s %8lu ns, %7lu instructions, %8lu bytes, %5lu allocations, %8lu allocated bytes\n",
+               spirv_parse_phase_name((spirv_parse_phase)p), ns, phase->instructions, phase->bytes, phase->allocations, phase->allocated_bytes);
+
+        snprintf(names[p], sizeof(names[p]), "phase %s", spirv_parse_phase_name((spirv_parse_phase)p));
+
+        bench_record(input, names[p], ns, (s64)phase->allocations, false);
+    }
+}
+
+void bench_parse(bench_input *input, u64 iterations)
+{
+    u64 parse_ns = 0;
+    u64 parse_arena_ns = 0;
+    u64 parse_validate_ns = 0;
+    u64 arena_blocks = 0;
+    u64 materialized_ns = 0;
+    u64 streaming_ns = 0;
+    u64 temp_bytes = 0;
+    s64 parse_allocs = 0;
+    s64 parse_arena_allocs = 0;
+    s64 parse_validate_allocs = 0;
+
+    bench_count_allocations(parse_allocs, _parse_once(input->data, false));
+    bench_count_allocations(parse_arena_allocs, _parse_once(input->data, true));
+    bench_count_allocations(parse_validate_allocs, _parse_once(input->data, false, true));
+
+    bench_run(parse_ns, iterations, _parse_once(input->data, false));
+    bench_run(parse_arena_ns, iterations, arena_blocks = _parse_once(input->data, true));
+    bench_run(parse_validate_ns, iterations, _parse_once(input->data, false, true));
+    bench_run(materialized_ns, iterations, temp_bytes = _walk_materialized(input->data));
+    bench_run(streaming_ns, iterations, bench_sink = bench_sink + _walk_streaming(input->data));
+
+    printf("%s (%lu bytes, %lu words, %lu instructions)\n", input->path, input->data.size, input->word_count, input->instruction_count);
+    printf("  parse_spirv_from_memory  %8lu ns\n", parse_ns);
+    bench_record(input, "parse_spirv_from_memory", parse_ns, parse_allocs);
+    printf("  parse, arena             %8lu ns, %lu arena blocks\n", parse_arena_ns, arena_blocks);
+    bench_record(input, "parse_spirv_from_memory, arena", parse_arena_ns, parse_arena_allocs);
+    printf("  parse, validating        %8lu ns, %+.1f%%\n", parse_validate_ns, parse_ns != 0 ? 100.0 * ((double)parse_validate_ns - (double)parse_ns) / (double)parse_ns : 0.0);
+    bench_record(input, "parse_spirv_from_memory, validating", parse_validate_ns, parse_validate_allocs);
+    printf("  walk, materialized       %8lu ns, %lu temporary bytes\n", materialized_ns, temp_bytes);
+    _print_id_table_size(input->data);
+    printf("  walk, streaming          %8lu ns, 0 temporary bytes\n", streaming_ns);
+    _print_memory_usage(input->data, false);
+    _print_memory_usage(input->data, true);
+    _print_parse_phases(input, iterations);
+}
+
+// parse plus pipeline reflection, reported per id so modules of
+// different sizes can be compared.
+static void _parse_and_reflect_once(memory_stream data)
+{
+    spirv_info info{};
+    init(&info);
+
+    spirv_pipeline_info pinfo{};
+    init(&pinfo);
+
+    if (!parse_spirv_from_memory(&data, &info, nullptr))
+        printf("  parse failed\n");
+    else
+        get_pipeline_info(&pinfo, &info);
+
+    bench_sink = bench_sink + pinfo.descriptor_sets.size;
+
+    free(&pinfo);
+    free(&info);
+}
+
+// collect_function_information stores its results in the functions,
+// they are released before every run so each run starts from scratch.
+static void _collect_functions_once(spirv_info *info)
+{
+    for_array(func, &info->functions)
+    {
+        free(func);
+        init(func);
+    }
+
+    collect_function_information(info);
+}
+
+static void _pipeline_info_once(spirv_info *info)
+{
+    spirv_pipeline_info pinfo{};
+    init(&pinfo);
+
+    get_pipeline_info(&pinfo, info);
+    bench_sink = bench_sink + pinfo.descriptor_sets.size;
+
+    free(&pinfo);
+}
+
+void bench_reflect(bench_input *input, u64 iterations)
+{
+    u64 bound = ((u32*)input->data.data)[3];
+    u64 ns = 0;
+    s64 allocs = 0;
+
+    bench_count_allocations(allocs, _parse_and_reflect_once(input->data));
+    bench_run(ns, iterations, _parse_and_reflect_once(input->data));
+
+    printf("  parse + get_pipeline_info %7lu ns, %.2f ns/id (%lu ids)\n", ns, (double)ns / (double)bound, bound);
+    bench_record(input, "parse + get_pipeline_info", ns, allocs);
+
+    spirv_info info{};
+    init(&info);
+
+    memory_stream data = input->data;
+
+    if (!parse_spirv_from_memory(&data, &info, nullptr))
+        return;
+
+    u64 pipeline_ns = 0;
+    bench_count_allocations(allocs, _pipeline_info_once(&info));
+    bench_run(pipeline_ns, iterations, _pipeline_info_once(&info));
+
+    printf("  get_pipeline_info        %8lu ns\n", pipeline_ns);
+    bench_record(input, "get_pipeline_info", pipeline_ns, allocs);
+
+    u64 layout_ns = 0;
+    bench_count_allocations(allocs, compute_type_layouts(&info, spirv_layout_rules_std430));
+    bench_run(layout_ns, iterations, compute_type_layouts(&info, spirv_layout_rules_std430));
+
+    printf("  compute_type_layouts     %8lu ns, %.2f ns/type (%lu types)\n", layout_ns, (double)layout_ns / (double)(info.types.size ? info.types.size : 1), info.types.size);
+    bench_record(input, "compute_type_layouts", layout_ns, allocs);
+
+    u64 functions_ns = 0;
+    bench_count_allocations(allocs, _collect_functions_once(&info));
+    bench_run(functions_ns, iterations, _collect_functions_once(&info));
+
+    printf("  collect_function_information %4lu ns, %lu functions\n", functions_ns, info.functions.size);
+    bench_record(input, "collect_function_information", functions_ns, allocs);
+
+    free(&info);
+}
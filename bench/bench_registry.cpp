@@ -0,0 +1,62 @@
+#include <stdio.h>
+
+#include "spirv_parser.hpp"
+#include "spirv_layout_registry.hpp"
+#include "bench.hpp"
+#include "bench_module.hpp"
+
+// pipeline_count pipelines whose modules have 1 to 8 uniform blocks, so
+// most of them share their layouts, like the pipelines of an engine.
+void bench_registry(u32 pipeline_count, u64 iterations)
+{
+    array<spirv_pipeline_info> pinfos{};
+    ::resize(&pinfos, pipeline_count);
+
+    for (u32 i = 0; i < pipeline_count; ++i)
+    {
+        bench_module_params params{};
+        params.uniform_blocks = 1 + i % 8;
+
+        memory_stream module{};
+        build_bench_module(&params, &module);
+
+        spirv_info info{};
+        init(&info);
+        init(pinfos.data + i);
+
+        memory_stream data = module;
+
+        if (parse_spirv_from_memory(&data, &info, nullptr))
+            get_pipeline_info(pinfos.data + i, &info);
+
+        free(&info);
+        ::close(&module);
+    }
+
+    u64 hash_ns = 0;
+    u64 register_ns = 0;
+
+    bench_run(hash_ns, iterations,
+    {
+        for_array(pinfo, &pinfos)
+            bench_sink = bench_sink + hash_pipeline_layout(pinfo);
+    });
+
+    spirv_layout_registry registry{};
+    init(&registry);
+
+    // the first round registers, every later one finds the layouts
+    bench_run(register_ns, iterations,
+    {
+        for_array(pinfo, &pinfos)
+            bench_sink = bench_sink + register_pipeline_layout(&registry, pinfo);
+    });
+
+    printf("layout registry, %u pipelines, %u set layouts, %u pipeline layouts\n",
+           pipeline_count, get_descriptor_set_count(&registry), get_pipeline_layout_count(&registry));
+    printf("  hash_pipeline_layout     %8lu ns, %.2f ns/pipeline\n", hash_ns, (double)hash_ns / pipeline_count);
+    printf("  register_pipeline_layout %8lu ns, %.2f ns/pipeline\n", register_ns, (double)register_ns / pipeline_count);
+
+    free(&registry);
+    ::free<true>(&pinfos);
+}
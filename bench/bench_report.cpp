@@ -0,0 +1,162 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <atomic>
+
+#include "shl/array.hpp"
+#include "shl/defer.hpp"
+#include "bench.hpp"
+
+void bench_count_instructions(bench_input *input)
+{
+    input->word_count = input->data.size / sizeof(u32);
+    input->instruction_count = 0;
+
+    if (input->word_count <= 5)
+        return;
+
+    const u32 *words = (const u32*)input->data.data;
+    u64 i = 5;
+
+    while (i < input->word_count)
+    {
+        u32 word_count = words[i] >> 16;
+
+        if (word_count == 0)
+            break;
+
+        i += word_count;
+        input->instruction_count++;
+    }
+}
+
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__)
+// the benchmark executable replaces the allocation functions of glibc
+// with counting wrappers, shl and the standard library allocate through
+// these as well. sanitizers replace them themselves.
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+
+static std::atomic<s64> _allocation_count{0};
+
+extern "C" void *malloc(size_t size) noexcept
+{
+    _allocation_count.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size) noexcept
+{
+    _allocation_count.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size) noexcept
+{
+    _allocation_count.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+
+s64 bench_allocation_count()
+{
+    return _allocation_count.load(std::memory_order_relaxed);
+}
+#else
+s64 bench_allocation_count()
+{
+    return -1;
+}
+#endif
+
+struct bench_result
+{
+    const char *input;
+    const char *name;
+    u64 ns;
+    u64 word_count;
+    u64 instruction_count;
+    s64 allocations;
+};
+
+static array<bench_result> _results{};
+
+static double _ns_per_word(const bench_result *r)
+{
+    return r->word_count != 0 ? (double)r->ns / (double)r->word_count : 0.0;
+}
+
+static double _instructions_per_second(const bench_result *r)
+{
+    return r->ns != 0 ? (double)r->instruction_count * 1e9 / (double)r->ns : 0.0;
+}
+
+void bench_record(const bench_input *input, const char *name, u64 ns, s64 allocations, bool print)
+{
+    bench_result r{};
+    r.input = input->path;
+    r.name = name;
+    r.ns = ns;
+    r.word_count = input->word_count;
+    r.instruction_count = input->instruction_count;
+    r.allocations = allocations;
+
+    ::add_at_end(&_results, r);
+
+    if (!print)
+        return;
+
+    printf("    %.3f ns/word, %.2f M instructions/s", _ns_per_word(&r), _instructions_per_second(&r) / 1e6);
+
+    if (allocations >= 0)
+        printf(", %ld allocations\n", allocations);
+    else
+        printf("\n");
+}
+
+static void _write_json_string(FILE *f, const char *str)
+{
+    fputc('"', f);
+
+    for (const char *c = str; *c != '\0'; ++c)
+    {
+        if (*c == '"' || *c == '\\')
+            fprintf(f, "\\%c", *c);
+        else if ((unsigned char)*c < 0x20)
+            fprintf(f, "\\u%04x", (unsigned)*c);
+        else
+            fputc(*c, f);
+    }
+
+    fputc('"', f);
+}
+
+bool bench_write_json(const char *path, u64 iterations)
+{
+    FILE *f = fopen(path, "w");
+
+    if (f == nullptr)
+        return false;
+
+    defer { fclose(f); };
+
+    // one result per line so that two runs can be diffed
+    fprintf(f, "{\n  \"iterations\": %lu,\n  \"results\": [\n", iterations);
+
+    for_array(i, r, &_results)
+    {
+        fprintf(f, "    {\"input\": ");
+        _write_json_string(f, r->input);
+        fprintf(f, ", \"name\": ");
+        _write_json_string(f, r->name);
+        fprintf(f, ", \"ns\": %lu, \"words\": %lu, \"instructions\": %lu, \"ns_per_word\": %.4f, \"instructions_per_s\": %.0f, \"allocations\": %ld}%s\n",
+                r->ns, r->word_count, r->instruction_count,
+                _ns_per_word(r), _instructions_per_second(r), r->allocations,
+                i + 1 < _results.size ? "," : "");
+    }
+
+    fprintf(f, "  ]\n}\n");
+
+    return true;
+}
@@ -0,0 +1,96 @@
+
+#include <stdio.h>
+
+#include "shl/defer.hpp"
+#include "spirv_parser.hpp"
+#include "bench.hpp"
+#include "bench_module.hpp"
+
+#define SCALING_STEPS 3
+#define SCALING_DIMENSIONS 6
+
+// the module size grows by 10x per step along one dimension, a
+// roughly constant ns/word means the parser scales linearly in it.
+struct _scaling_dimension
+{
+    const char *name;
+    u32 bench_module_params::*param;
+    u32 first;
+    u32 functions; // for function_size
+};
+
+static const _scaling_dimension _dimensions[SCALING_DIMENSIONS] = {
+    {"constants",      &bench_module_params::constants,      10000, 0},
+    {"uniform_blocks", &bench_module_params::uniform_blocks, 1000,  0},
+    {"struct_depth",   &bench_module_params::struct_depth,   100,   0},
+    {"functions",      &bench_module_params::functions,      1000,  0},
+    {"function_size",  &bench_module_params::function_size,  100,   100},
+    {"call_depth",     &bench_module_params::call_depth,     1000,  0},
+};
+
+// bench_record keeps the input name
+static char _names[SCALING_DIMENSIONS * SCALING_STEPS][64];
+
+static void _parse_and_reflect_once(memory_stream data)
+{
+    spirv_info info{};
+    init(&info);
+
+    spirv_pipeline_info pinfo{};
+    init(&pinfo);
+
+    if (!parse_spirv_from_memory(&data, &info, nullptr))
+        printf("  parse failed\n");
+    else
+        get_pipeline_info(&pinfo, &info);
+
+    bench_sink = bench_sink + pinfo.descriptor_sets.size;
+
+    free(&pinfo);
+    free(&info);
+}
+
+void bench_scaling(u64 iterations)
+{
+    printf("scaling, parse + get_pipeline_info\n");
+
+    for (u32 d = 0; d < SCALING_DIMENSIONS; ++d)
+    {
+        const _scaling_dimension *dim = _dimensions + d;
+        double first_ns_per_word = 0;
+        u32 value = dim->first;
+
+        for (u32 step = 0; step < SCALING_STEPS; ++step, value *= 10)
+        {
+            bench_module_params params{};
+            params.uniform_blocks = 16;
+            params.functions = dim->functions;
+            params.*(dim->param) = value;
+
+            char *name = _names[d * SCALING_STEPS + step];
+            snprintf(name, sizeof(_names[0]), "scaling, %s=%u", dim->name, value);
+
+            bench_input input{};
+            input.path = name;
+            build_bench_module(&params, &input.data);
+            defer { ::close(&input.data); };
+            bench_count_instructions(&input);
+
+            u64 ns = 0;
+            s64 allocs = 0;
+
+            bench_count_allocations(allocs, _parse_and_reflect_once(input.data));
+            bench_run(ns, iterations, _parse_and_reflect_once(input.data));
+
+            double ns_per_word = (double)ns / (double)input.word_count;
+
+            if (step == 0)
+                first_ns_per_word = ns_per_word;
+
+            printf("  %-14s %8u %10lu words %10lu ns, %.2fx ns/word of the smallest\n",
+                   dim->name, value, input.word_count, ns, ns_per_word / first_ns_per_word);
+
+            bench_record(&input, "parse + get_pipeline_info", ns, allocs);
+        }
+    }
+}
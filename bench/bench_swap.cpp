@@ -0,0 +1,64 @@
+#include <stdio.h>
+
+#include "shl/memory.hpp"
+#include "spirv_parser.hpp"
+#include "spirv_swap.hpp"
+#include "bench.hpp"
+
+static void _print_throughput(const char *label, u64 ns, u64 bytes)
+{
+    double gb_per_s = ns != 0 ? (double)bytes / (double)ns : 0.0;
+    printf("  byteswap, %-14s %8lu ns, %.2f GB/s\n", label, ns, gb_per_s);
+}
+
+// a byte-reversed module is converted into a copy by the parser
+static void _parse_once(const memory_stream *module)
+{
+    memory_stream data = *module;
+    data.position = 0;
+
+    spirv_info info{};
+    init(&info);
+
+    if (!parse_spirv_from_memory(&data, &info, nullptr))
+        printf("  parse failed\n");
+
+    bench_sink = bench_sink + info.types.size;
+
+    free(&info);
+}
+
+void bench_swap(bench_input *input, u64 iterations)
+{
+    u64 word_count = input->data.size / sizeof(u32);
+    u64 bytes = word_count * sizeof(u32);
+
+    memory_stream swapped{};
+    memory_stream scratch{};
+    ::open(&swapped, bytes);
+    ::open(&scratch, input->data.size);
+
+    byteswap_words((u32*)swapped.data, (const u32*)input->data.data, word_count, spirv_byteswap_isa_scalar);
+
+    spirv_byteswap_isa best = get_best_byteswap_isa();
+
+    for (u8 isa = spirv_byteswap_isa_scalar; isa <= best; ++isa)
+    {
+        u64 ns = 0;
+        bench_run(ns, iterations, byteswap_words((u32*)scratch.data, (const u32*)swapped.data, word_count, (spirv_byteswap_isa)isa));
+        bench_sink = bench_sink + ((u32*)scratch.data)[0];
+
+        _print_throughput(byteswap_isa_name((spirv_byteswap_isa)isa), ns, bytes);
+    }
+
+    u64 native_ns = 0;
+    u64 swapped_ns = 0;
+    bench_run(native_ns, iterations, _parse_once(&input->data));
+    bench_run(swapped_ns, iterations, _parse_once(&swapped));
+
+    printf("  parse, native endian     %8lu ns\n", native_ns);
+    printf("  parse, opposite endian   %8lu ns (incl. copy)\n", swapped_ns);
+
+    ::close(&swapped);
+    ::close(&scratch);
+}
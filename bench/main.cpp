@@ -0,0 +1,131 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "shl/defer.hpp"
+#include "bench.hpp"
+#include "bench_module.hpp"
+
+static const char *default_inputs[] = {
+    "res/shaders.spv",
+    "res/texture2d.spv",
+};
+
+int main(int argc, char **argv)
+{
+    u64 iterations = 10000;
+
+    const char **paths = default_inputs;
+    int path_count = sizeof(default_inputs) / sizeof(default_inputs[0]);
+    const char *json_path = getenv("SPIRV_BENCH_JSON");
+
+    // --json <path> may come before the inputs
+    if (argc >= 3 && strcmp(argv[1], "--json") == 0)
+    {
+        json_path = argv[2];
+        argv += 2;
+        argc -= 2;
+    }
+
+    if (argc >= 2)
+    {
+        paths = (const char **)(argv + 1);
+        path_count = argc - 1;
+    }
+
+    if (const char *it = getenv("SPIRV_BENCH_ITERATIONS"))
+        iterations = strtoull(it, nullptr, 10);
+
+    // 0 or a non numeric value, the benchmarks divide by iterations
+    if (iterations == 0)
+        iterations = 1;
+
+    for (int i = 0; i < path_count; ++i)
+    {
+        bench_input input{};
+        input.path = paths[i];
+        defer { ::close(&input.data); };
+
+        error err{};
+
+        if (!::read_entire_file(input.path, &input.data, &err))
+        {
+            printf("error: could not read %s: %s\n", input.path, err.what);
+            return 1;
+        }
+
+        bench_count_instructions(&input);
+        bench_parse(&input, iterations);
+        bench_reflect(&input, iterations);
+        bench_load(&input, iterations);
+        bench_cache(&input, iterations);
+        bench_swap(&input, iterations);
+    }
+
+    // synthetic modules with a bound above 100k ids. with 1.4 reflection
+    // uses the entry point interface instead of walking function bodies.
+    const char *synthetic_names[] = {"synthetic, SPIR-V 1.0", "synthetic, SPIR-V 1.4"};
+    const u32 synthetic_versions[] = {0x00010000, 0x00010400};
+
+    for (int v = 0; v < 2; ++v)
+    {
+        bench_module_params params{};
+        params.constants = 50000;
+        params.uniform_blocks = 20000;
+        params.version = synthetic_versions[v];
+
+        bench_input input{};
+        input.path = synthetic_names[v];
+        build_bench_module(&params, &input.data);
+        defer { ::close(&input.data); };
+        bench_count_instructions(&input);
+
+        u64 large_iterations = iterations / 1000;
+
+        if (large_iterations == 0)
+            large_iterations = 1;
+
+        bench_parse(&input, large_iterations);
+        bench_reflect(&input, large_iterations);
+        bench_cache(&input, large_iterations);
+        bench_swap(&input, large_iterations);
+    }
+
+    {
+        u64 batch_iterations = iterations / 1000;
+
+        if (batch_iterations == 0)
+            batch_iterations = 1;
+
+        bench_batch(512, batch_iterations);
+    }
+
+    bench_merge(5, 64, iterations);
+
+    {
+        u64 registry_iterations = iterations / 100;
+
+        if (registry_iterations == 0)
+            registry_iterations = 1;
+
+        bench_registry(1000, registry_iterations);
+    }
+
+    {
+        u64 scaling_iterations = iterations / 10000;
+
+        if (scaling_iterations == 0)
+            scaling_iterations = 1;
+
+        bench_scaling(scaling_iterations);
+    }
+
+    if (json_path != nullptr && !bench_write_json(json_path, iterations))
+    {
+        printf("error: could not write %s\n", json_path);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,111 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench_module.hpp"
+
+static void _usage()
+{
+    printf("usage: spirv-parser-gen [options] <output.spv>\n"
+           "  --constants <n>       OpConstants, mostly to grow the bound\n"
+           "  --uniform-blocks <n>  decorated uniform block variables (16 bindings per set)\n"
+           "  --struct-depth <n>    nested structs inside every uniform block\n"
+           "  --functions <n>       functions called from main\n"
+           "  --function-size <n>   instructions in the body of each of those functions\n"
+           "  --call-depth <n>      chain of calls from main to the function accessing the blocks\n"
+           "  --version <1.x>       SPIR-V version of the module, default 1.0\n");
+}
+
+static bool _parse_version(const char *str, u32 *out)
+{
+    unsigned major = 0;
+    unsigned minor = 0;
+
+    if (sscanf(str, "%u.%u", &major, &minor) != 2 || major != 1 || minor > 6)
+        return false;
+
+    *out = (major << 16) | (minor << 8);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    bench_module_params params{};
+    const char *out_path = nullptr;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const char *arg = argv[i];
+
+        if (arg[0] != '-')
+        {
+            out_path = arg;
+            continue;
+        }
+
+        if (i + 1 >= argc)
+        {
+            _usage();
+            return 1;
+        }
+
+        const char *value = argv[++i];
+        u32 n = (u32)strtoul(value, nullptr, 10);
+
+        if      (strcmp(arg, "--constants") == 0)      params.constants = n;
+        else if (strcmp(arg, "--uniform-blocks") == 0) params.uniform_blocks = n;
+        else if (strcmp(arg, "--struct-depth") == 0)   params.struct_depth = n;
+        else if (strcmp(arg, "--functions") == 0)      params.functions = n;
+        else if (strcmp(arg, "--function-size") == 0)  params.function_size = n;
+        else if (strcmp(arg, "--call-depth") == 0)     params.call_depth = n;
+        else if (strcmp(arg, "--version") == 0)
+        {
+            if (!_parse_version(value, &params.version))
+            {
+                printf("error: invalid version %s\n", value);
+                return 1;
+            }
+        }
+        else
+        {
+            _usage();
+            return 1;
+        }
+    }
+
+    if (out_path == nullptr)
+    {
+        _usage();
+        return 1;
+    }
+
+    memory_stream module{};
+    build_bench_module(&params, &module);
+
+    FILE *f = fopen(out_path, "wb");
+
+    if (f == nullptr)
+    {
+        printf("error: could not open %s\n", out_path);
+        ::close(&module);
+        return 1;
+    }
+
+    u64 written = fwrite(module.data, 1, module.size, f);
+    fclose(f);
+
+    u32 bound = ((u32*)module.data)[3];
+    u64 size = module.size;
+    ::close(&module);
+
+    if (written != size)
+    {
+        printf("error: could not write %s\n", out_path);
+        return 1;
+    }
+
+    printf("%s: %lu bytes, bound %u\n", out_path, size, bound);
+
+    return 0;
+}
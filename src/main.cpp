@@ -1,9 +1,12 @@
 
 #include <stdio.h>
+#include <string.h>
 
 #include "shl/defer.hpp"
 
 #include "spirv_parser.hpp"
+#include "spirv_batch.hpp"
+#include "spirv_codegen.hpp"
 
 void print_shader_stage_flags(VkShaderStageFlags stages)
 {
@@ -50,18 +53,28 @@ void print_descriptor_type(VkDescriptorType type)
     }
 }
 
-void print_pipeline_info(spirv_info *info)
+void print_descriptor_binding_flags(VkDescriptorBindingFlags flags)
 {
-    spirv_pipeline_info pinfo{};
-    init(&pinfo);
-    defer { free(&pinfo); };
+    const char *separator = "";
 
-    get_pipeline_info(&pinfo, info);
+#define PRINT_FLAG_IF_SET(FLAG)\
+    if ((flags & FLAG) == FLAG) { printf("%s%s", separator, #FLAG); separator = " | "; }
+
+    PRINT_FLAG_IF_SET(VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT);
+    PRINT_FLAG_IF_SET(VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT);
+    PRINT_FLAG_IF_SET(VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT);
+    PRINT_FLAG_IF_SET(VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT);
+
+#undef PRINT_FLAG_IF_SET
+}
+
+void print_pipeline_info(spirv_pipeline_info *pinfo)
+{
 
     printf("\nPipeline info:\n");
     printf("Push constants:\n");
     
-    for_array(pc, &pinfo.push_constants)
+    for_array(pc, &pinfo->push_constants)
     {
         printf(R"=(  VkPushConstantRange{
     .stageFlags = )=");
@@ -73,9 +86,14 @@ void print_pipeline_info(spirv_info *info)
 )=", pc->offset, pc->size);
     }
 
+    u32 push_constants_size = get_push_constants_size(pinfo);
+
+    if (push_constants_size > SPIRV_GUARANTEED_PUSH_CONSTANTS_SIZE)
+        printf("  warning: push constants use %u bytes, only %u are guaranteed\n", push_constants_size, SPIRV_GUARANTEED_PUSH_CONSTANTS_SIZE);
+
     printf("\nDescriptor sets:\n");
 
-    for_array(i, dset, &pinfo.descriptor_sets)
+    for_array(i, dset, &pinfo->descriptor_sets)
     {
         printf("  set %lu:\n", i);
 
@@ -94,8 +112,117 @@ void print_pipeline_info(spirv_info *info)
       .pImmutableSamplers = %p
     };
 )=", binding->pImmutableSamplers);
+
+            if (dset->binding_flags[j] != 0)
+            {
+                printf("    binding flags: ");
+                print_descriptor_binding_flags(dset->binding_flags[j]);
+                printf("\n");
+            }
+        }
+    }
+}
+
+// more than one input: parse all of them in parallel, no disassembly
+int main_batch(int argc, char **argv)
+{
+    array<spirv_batch_input> inputs{};
+    defer { ::free(&inputs); };
+
+    for (int i = 1; i < argc; ++i)
+    {
+        spirv_batch_input *input = ::add_at_end(&inputs);
+        ::fill_memory(input, 0);
+        input->path = argv[i];
+    }
+
+    spirv_batch_options options{};
+    init(&options);
+    options.parse.use_mmap = true;
+
+    array<spirv_batch_result> results{};
+    defer { ::free<true>(&results); };
+
+    bool ok = parse_spirv_batch(inputs.data, inputs.size, &results, &options);
+
+    for_array(i, result, &results)
+    {
+        printf("\n%s:\n", inputs[i].path);
+
+        if (!result->success)
+        {
+            printf("error: %s\n", result->err.what);
+            continue;
         }
+
+        print_pipeline_info(&result->pipeline);
+    }
+
+    return ok ? 0 : 2;
+}
+
+// --header <input> <output> [namespace]: generate a C++ header with the
+// pipeline layout of input, the namespace defaults to the input file name.
+int main_header(int argc, char **argv)
+{
+    if (argc < 4)
+    {
+        printf("usage: %s --header <input.spv> <output.hpp> [namespace]\n", argv[0]);
+        return 1;
     }
+
+    const char *input = argv[2];
+    const char *output = argv[3];
+    char name_space[256];
+
+    if (argc > 4)
+        snprintf(name_space, sizeof(name_space), "%s", argv[4]);
+    else
+    {
+        const char *base = input;
+
+        for (const char *c = input; *c != '\0'; ++c)
+            if (*c == '/' || *c == '\\')
+                base = c + 1;
+
+        char stem[256];
+        snprintf(stem, sizeof(stem), "%s", base);
+
+        if (char *dot = strchr(stem, '.'))
+            *dot = '\0';
+
+        to_identifier(stem, name_space, sizeof(name_space));
+    }
+
+    spirv_info info{};
+    defer { free(&info); };
+    init(&info);
+
+    spirv_parse_options options{};
+    init(&options);
+    options.use_mmap = true;
+
+    error err{};
+
+    if (!parse_spirv_from_file(input, &info, &err, &options))
+    {
+        printf("error: %s\n", err.what);
+        return 2;
+    }
+
+    spirv_pipeline_info pinfo{};
+    init(&pinfo);
+    defer { free(&pinfo); };
+
+    get_pipeline_info(&pinfo, &info);
+
+    if (!write_pipeline_header_file(output, &info, &pinfo, name_space, &err))
+    {
+        printf("error: %s\n", err.what);
+        return 2;
+    }
+
+    return 0;
 }
 
 int main(int argc, char **argv)
@@ -106,19 +233,35 @@ int main(int argc, char **argv)
         return 1;
     }
 
+    if (strcmp(argv[1], "--header") == 0)
+        return main_header(argc, argv);
+
+    if (argc > 2)
+        return main_batch(argc, argv);
+
     spirv_info output{};
     defer { free(&output); };
     init(&output);
 
+    spirv_parse_options options{};
+    init(&options);
+    options.trace = spirv_disassembly_trace_sink(stdout);
+    options.use_mmap = true;
+
     error err{};
 
-    if (!parse_spirv_from_file(argv[1], &output, &err))
+    if (!parse_spirv_from_file(argv[1], &output, &err, &options))
     {
         printf("error: %s", err.what);
         return 2;
     }
 
-    print_pipeline_info(&output);
+    spirv_pipeline_info pinfo{};
+    init(&pinfo);
+    defer { free(&pinfo); };
+
+    get_pipeline_info(&pinfo, &output, &options.trace);
+    print_pipeline_info(&pinfo);
 
     return 0;
 }
@@ -0,0 +1,105 @@
+
+#include <assert.h>
+
+#include "shl/memory.hpp"
+#include "spirv_arena.hpp"
+
+#define align_up(X, A) (((X) + ((A) - 1)) & ~((A) - 1))
+
+static spirv_arena_block *_add_block(spirv_arena *arena, u64 size)
+{
+    if (size < arena->block_size)
+        size = arena->block_size;
+
+    spirv_arena_block *block = (spirv_arena_block*)::allocate_memory(sizeof(spirv_arena_block) + size);
+    block->next = arena->blocks;
+    block->size = size;
+    block->used = 0;
+
+    arena->blocks = block;
+    arena->block_count++;
+
+    return block;
+}
+
+void init(spirv_arena *arena, u64 block_size)
+{
+    assert(arena != nullptr);
+
+    arena->blocks = nullptr;
+    arena->block_size = block_size;
+    arena->block_count = 0;
+    arena->allocated_bytes = 0;
+}
+
+void free(spirv_arena *arena)
+{
+    if (arena == nullptr)
+        return;
+
+    spirv_arena_block *block = arena->blocks;
+
+    while (block != nullptr)
+    {
+        spirv_arena_block *next = block->next;
+        ::free_memory(block);
+        block = next;
+    }
+
+    arena->blocks = nullptr;
+    arena->allocated_bytes = 0;
+}
+
+void reserve(spirv_arena *arena, u64 size)
+{
+    assert(arena != nullptr);
+
+    spirv_arena_block *block = arena->blocks;
+
+    if (block != nullptr && block->size - block->used >= size)
+        return;
+
+    _add_block(arena, size);
+}
+
+static u64 _aligned_offset(spirv_arena_block *block, u64 alignment)
+{
+    u64 base = (u64)(block + 1);
+    return align_up(base + block->used, alignment) - base;
+}
+
+void *allocate(spirv_arena *arena, u64 size, u64 alignment)
+{
+    assert(arena != nullptr);
+    assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+    if (size == 0)
+        return nullptr;
+
+    spirv_arena_block *block = arena->blocks;
+    u64 offset = 0;
+
+    if (block != nullptr)
+        offset = _aligned_offset(block, alignment);
+
+    if (block == nullptr || offset + size > block->size)
+    {
+        block = _add_block(arena, size + alignment);
+        offset = _aligned_offset(block, alignment);
+    }
+
+    block->used = offset + size;
+    arena->allocated_bytes += size;
+
+    return (u8*)(block + 1) + offset;
+}
+
+u64 get_block_bytes(const spirv_arena *arena)
+{
+    u64 bytes = 0;
+
+    for (spirv_arena_block *block = arena->blocks; block != nullptr; block = block->next)
+        bytes += sizeof(spirv_arena_block) + block->size;
+
+    return bytes;
+}
@@ -0,0 +1,40 @@
+
+#pragma once
+
+#include "shl/number_types.hpp"
+
+// simple bump allocator. memory is never freed individually, only
+// all at once with free(arena).
+struct spirv_arena_block
+{
+    spirv_arena_block *next;
+    u64 size; // usable bytes after the header
+    u64 used;
+};
+
+struct spirv_arena
+{
+    spirv_arena_block *blocks; // most recent block first
+    u64 block_size; // minimum size of new blocks
+    u64 block_count; // number of heap allocations done by the arena
+    u64 allocated_bytes; // bytes handed out, excluding padding
+};
+
+#define SPIRV_ARENA_DEFAULT_BLOCK_SIZE (64 * 1024)
+
+void init(spirv_arena *arena, u64 block_size = SPIRV_ARENA_DEFAULT_BLOCK_SIZE);
+void free(spirv_arena *arena);
+
+// makes sure at least size bytes can be allocated without another block
+void reserve(spirv_arena *arena, u64 size);
+
+void *allocate(spirv_arena *arena, u64 size, u64 alignment);
+
+// heap bytes held by the arena, i.e. all blocks including their headers
+u64 get_block_bytes(const spirv_arena *arena);
+
+template<typename T>
+T *allocate(spirv_arena *arena, u64 count)
+{
+    return (T*)allocate(arena, sizeof(T) * count, alignof(T));
+}
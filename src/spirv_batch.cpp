@@ -0,0 +1,217 @@
+
+#include <assert.h>
+#include <atomic>
+#include <new>
+#include <thread>
+
+#include "shl/memory.hpp"
+#include "spirv_batch.hpp"
+
+void init(spirv_batch_result *result)
+{
+    assert(result != nullptr);
+
+    ::fill_memory(result, 0);
+    init(&result->info);
+    init(&result->pipeline);
+}
+
+void free(spirv_batch_result *result)
+{
+    if (result == nullptr)
+        return;
+
+    free(&result->info);
+    free(&result->pipeline);
+}
+
+void init(spirv_batch_options *options)
+{
+    assert(options != nullptr);
+
+    init(&options->parse);
+    options->thread_count = 0;
+}
+
+// work stealing queue over a range of input indices.
+// begin (low 32 bits) and end (high 32 bits) share one atomic so the
+// owner taking from the front and thieves taking from the back never
+// hand out the same index.
+struct _batch_queue
+{
+    std::atomic<u64> range;
+    u8 _padding[64 - sizeof(std::atomic<u64>)]; // one cache line per queue
+};
+
+#define _range(BEGIN, END) (((u64)(END) << 32) | (u64)(BEGIN))
+#define _range_begin(R) ((u32)((R) & 0xffffffff))
+#define _range_end(R)   ((u32)((R) >> 32))
+
+static bool _pop_front(_batch_queue *q, u32 *out)
+{
+    u64 r = q->range.load(std::memory_order_acquire);
+
+    while (_range_begin(r) < _range_end(r))
+    {
+        if (q->range.compare_exchange_weak(r, _range(_range_begin(r) + 1, _range_end(r)), std::memory_order_acq_rel))
+        {
+            *out = _range_begin(r);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// moves the back half of victims range into thiefs (empty) queue.
+// only the owner writes to an empty queue, so the plain store is safe.
+static bool _steal(_batch_queue *victim, _batch_queue *thief)
+{
+    u64 r = victim->range.load(std::memory_order_acquire);
+
+    while (_range_begin(r) < _range_end(r))
+    {
+        u32 begin = _range_begin(r);
+        u32 end = _range_end(r);
+        u32 take = (end - begin + 1) / 2;
+
+        if (victim->range.compare_exchange_weak(r, _range(begin, end - take), std::memory_order_acq_rel))
+        {
+            thief->range.store(_range(end - take, end), std::memory_order_release);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+struct _batch_context
+{
+    const spirv_batch_input *inputs;
+    spirv_batch_result *results;
+    const spirv_parse_options *parse_options;
+    _batch_queue *queues;
+    u32 queue_count;
+    std::atomic<bool> all_succeeded;
+};
+
+static void _process(_batch_context *ctx, u32 index)
+{
+    const spirv_batch_input *input = ctx->inputs + index;
+    spirv_batch_result *result = ctx->results + index;
+
+    // the shared stats would be written by all workers at once
+    spirv_parse_options options = *ctx->parse_options;
+
+    if (options.stats != nullptr)
+        options.stats = &result->stats;
+
+    if (input->path != nullptr)
+        result->success = parse_spirv_from_file(input->path, &result->info, &result->err, &options);
+    else
+    {
+        // the parser advances the stream, each module gets its own copy
+        memory_stream data = input->data;
+        data.position = 0;
+        result->success = parse_spirv_from_memory(&data, &result->info, &result->err, &options);
+    }
+
+    if (result->success)
+        get_pipeline_info(&result->pipeline, &result->info, &options.trace);
+    else
+        ctx->all_succeeded.store(false, std::memory_order_relaxed);
+}
+
+static void _worker(_batch_context *ctx, u32 worker_index)
+{
+    _batch_queue *own = ctx->queues + worker_index;
+    u32 index;
+
+    while (true)
+    {
+        while (_pop_front(own, &index))
+            _process(ctx, index);
+
+        bool stole = false;
+
+        for (u32 i = 1; i < ctx->queue_count && !stole; ++i)
+            stole = _steal(ctx->queues + (worker_index + i) % ctx->queue_count, own);
+
+        // indices in transit between two queues are processed by the
+        // thief, so stopping here never drops work.
+        if (!stole)
+            break;
+    }
+}
+
+bool parse_spirv_batch(const spirv_batch_input *inputs, u64 input_count, array<spirv_batch_result> *results, const spirv_batch_options *options)
+{
+    assert(inputs != nullptr || input_count == 0);
+    assert(results != nullptr);
+    assert(input_count <= max_value(u32));
+
+    spirv_batch_options default_options{};
+
+    if (options == nullptr)
+    {
+        init(&default_options);
+        options = &default_options;
+    }
+
+    ::resize(results, input_count);
+
+    for_array(result, results)
+        init(result);
+
+    if (input_count == 0)
+        return true;
+
+    u32 thread_count = options->thread_count;
+
+    if (thread_count == 0)
+        thread_count = std::thread::hardware_concurrency();
+
+    if (thread_count == 0)
+        thread_count = 1;
+
+    if (thread_count > input_count)
+        thread_count = (u32)input_count;
+
+    _batch_queue *queues = ::allocate_memory<_batch_queue>(thread_count);
+
+    // contiguous initial split, stealing evens out uneven module sizes
+    for (u32 i = 0; i < thread_count; ++i)
+    {
+        u32 begin = (u32)((input_count * i) / thread_count);
+        u32 end = (u32)((input_count * (i + 1)) / thread_count);
+        new (queues + i) _batch_queue{};
+        queues[i].range.store(_range(begin, end), std::memory_order_relaxed);
+    }
+
+    _batch_context ctx{};
+    ctx.inputs = inputs;
+    ctx.results = results->data;
+    ctx.parse_options = &options->parse;
+    ctx.queues = queues;
+    ctx.queue_count = thread_count;
+    ctx.all_succeeded.store(true, std::memory_order_relaxed);
+
+    std::thread *threads = ::allocate_memory<std::thread>(thread_count - 1);
+
+    for (u32 i = 1; i < thread_count; ++i)
+        new (threads + i - 1) std::thread(_worker, &ctx, i);
+
+    // the calling thread is worker 0
+    _worker(&ctx, 0);
+
+    for (u32 i = 1; i < thread_count; ++i)
+    {
+        threads[i - 1].join();
+        threads[i - 1].~thread();
+    }
+
+    ::free_memory(threads);
+    ::free_memory(queues);
+
+    return ctx.all_succeeded.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "spirv_parser.hpp"
+
+// parses and reflects many modules on a pool of worker threads.
+// each input is either a path or a memory buffer. memory inputs are
+// borrowed: results point into them and must not outlive them. they are
+// only read, so the same buffer may be listed several times.
+struct spirv_batch_input
+{
+    const char *path; // used if not nullptr, otherwise data
+    memory_stream data;
+};
+
+struct spirv_batch_result
+{
+    bool success;
+    error err; // set if success is false
+    spirv_info info;
+    spirv_pipeline_info pipeline;
+    spirv_parse_stats stats; // filled if options.parse.stats is not nullptr
+};
+
+void init(spirv_batch_result *result);
+// memory inputs are borrowed and not closed
+void free(spirv_batch_result *result);
+
+struct spirv_batch_options
+{
+    // used for every module. the trace sink is called from all worker
+    // threads at once and should be the null sink unless it is thread safe.
+    // parse.stats is never written, if it is not nullptr every module
+    // writes its statistics to the stats of its own result instead.
+    spirv_parse_options parse;
+
+    // total number of threads including the calling thread,
+    // 0 uses one per hardware thread.
+    u32 thread_count;
+};
+
+void init(spirv_batch_options *options);
+
+// results receives one entry per input, in input order.
+// returns true if every module was parsed successfully, failed modules
+// have success = false and their error in err.
+// free the results with free<true>(results).
+bool parse_spirv_batch(const spirv_batch_input *inputs, u64 input_count, array<spirv_batch_result> *results, const spirv_batch_options *options = nullptr);
@@ -0,0 +1,614 @@
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <process.h>
+#define _process_id() _getpid()
+#else
+#include <unistd.h>
+#define _process_id() getpid()
+#endif
+
+#include "shl/memory.hpp"
+#include "shl/string.hpp"
+#include "shl/defer.hpp"
+#include "spirv_blob.hpp"
+
+#define get_spirv_blob_error(ERR, FMT, ...) \
+    if (ERR != nullptr) { *ERR = error{.what = format_error(FMT __VA_OPT__(,) __VA_ARGS__), .file = __FILE__, .line = __LINE__}; }
+
+#define align_up(X, A) (((X) + ((A) - 1)) & ~((u64)(A) - 1))
+
+#define NO_INDEX max_value(u32)
+
+#define SPIRV_BLOB_SWAPPED_MAGIC 0x53505242
+
+// strings are appended once, offset 0 is the empty string
+static u32 _add_string(array<char> *strings, const char *str)
+{
+    if (str == nullptr || str[0] == '\0')
+        return 0;
+
+    u32 offset = (u32)strings->size;
+    u64 length = string_length(str);
+
+    for (u64 i = 0; i <= length; ++i)
+        ::add_at_end(strings, str[i]);
+
+    return offset;
+}
+
+static u32 _struct_index(spirv_info *info, const array<u32> *struct_indices, SpvId type_id)
+{
+    spirv_type *t = get_type_by_id(info, type_id);
+
+    if (t == nullptr)
+        return NO_INDEX;
+
+    return struct_indices->data[t - info->types.data];
+}
+
+// follows the pointer of a block variable and arrays of blocks
+static u32 _block_struct_index(spirv_info *info, const array<u32> *struct_indices, SpvId pointer_type_id)
+{
+    spirv_type *t = get_type_by_id(info, pointer_type_id);
+
+    if (t == nullptr || t->instruction.opcode != SpvOpTypePointer)
+        return NO_INDEX;
+
+    t = get_type_by_id(info, (SpvId)t->instruction.words[3]);
+
+    while (t != nullptr
+       && (t->instruction.opcode == SpvOpTypeArray || t->instruction.opcode == SpvOpTypeRuntimeArray))
+        t = get_type_by_id(info, (SpvId)t->instruction.words[2]);
+
+    if (t == nullptr)
+        return NO_INDEX;
+
+    return struct_indices->data[t - info->types.data];
+}
+
+static void _get_set_and_binding(spirv_info *info, SpvId id, u32 *set, u32 *binding)
+{
+    *set = NO_INDEX;
+    *binding = NO_INDEX;
+
+    u32 count = 0;
+    u32 *indices = get_decoration_indices(info, id, &count);
+
+    for (u32 d = 0; d < count; ++d)
+    {
+        spirv_instruction *decor = info->decorations.data + indices[d];
+
+        if (decor->opcode != SpvOpDecorate)
+            continue;
+
+        if (decor->words[2] == SpvDecorationDescriptorSet)
+            *set = decor->words[3];
+        else if (decor->words[2] == SpvDecorationBinding)
+            *binding = decor->words[3];
+    }
+}
+
+bool write_spirv_blob(spirv_info *info, const spirv_pipeline_info *pinfo, memory_stream *out, error *err)
+{
+    assert(info != nullptr);
+    assert(pinfo != nullptr);
+    assert(out != nullptr);
+
+    array<char> strings{};
+    array<u32> struct_indices{}; // per type of info
+    array<spirv_blob_struct> structs{};
+    array<spirv_blob_member> members{};
+    array<spirv_blob_block> blocks{};
+
+    defer
+    {
+        ::free(&strings);
+        ::free(&struct_indices);
+        ::free(&structs);
+        ::free(&members);
+        ::free(&blocks);
+    };
+
+    ::add_at_end(&strings, '\0');
+
+    // structs first, so members can refer to structs declared after them
+    ::resize(&struct_indices, info->types.size);
+
+    for_array(i, t, &info->types)
+    {
+        struct_indices[i] = NO_INDEX;
+
+        if (t->instruction.opcode != SpvOpTypeStruct)
+            continue;
+
+        struct_indices[i] = (u32)structs.size;
+        ::add_at_end(&structs, spirv_blob_struct{});
+    }
+
+    for_array(t, &info->types)
+    {
+        u32 index = struct_indices[t - info->types.data];
+
+        if (index == NO_INDEX)
+            continue;
+
+        spirv_blob_struct *st = structs.data + index;
+        st->id = t->id;
+        st->name = _add_string(&strings, get_id_name(info, t->id));
+        st->size = (u32)t->size;
+        st->alignment = t->alignment;
+        st->first_member = (u32)members.size;
+        st->member_count = (u32)t->members.size;
+
+        for_array(mem, &t->members)
+        {
+            spirv_blob_member *bm = ::add_at_end(&members);
+            bm->name = _add_string(&strings, mem->name);
+            bm->offset = (u32)mem->offset;
+            bm->size = (u32)mem->size;
+            bm->struct_index = _struct_index(info, &struct_indices, mem->type_id);
+        }
+    }
+
+    // only blocks an entry point uses, like the pipeline info
+    array<bool> used{};
+    defer { ::free(&used); };
+    ::resize(&used, info->variables.size);
+    ::fill_memory(used.data, 0, used.size);
+
+    for_array(ep, &info->entry_points)
+    for_array(var, &info->functions[ep->function_index].referenced_variables)
+        used[*var - info->variables.data] = true;
+
+    for_array(i, var, &info->variables)
+    {
+        if (!used[i] || var->instruction.opcode != SpvOpVariable)
+            continue;
+
+        SpvStorageClass storage = (SpvStorageClass)var->instruction.words[3];
+
+        if (storage != SpvStorageClassUniform
+         && storage != SpvStorageClassStorageBuffer
+         && storage != SpvStorageClassPushConstant)
+            continue;
+
+        u32 struct_index = _block_struct_index(info, &struct_indices, (SpvId)var->instruction.words[1]);
+
+        if (struct_index == NO_INDEX)
+            continue;
+
+        spirv_blob_block *block = ::add_at_end(&blocks);
+        block->name = _add_string(&strings, get_id_name(info, var->id));
+        block->storage_class = (u32)storage;
+        block->struct_index = struct_index;
+
+        if (storage == SpvStorageClassPushConstant)
+        {
+            block->set = NO_INDEX;
+            block->binding = NO_INDEX;
+        }
+        else
+            _get_set_and_binding(info, var->id, &block->set, &block->binding);
+    }
+
+    // unused bindings in the pipeline info have no descriptors and are
+    // left out, so each set is a plain array of its bindings.
+    u64 binding_count = 0;
+
+    for_array(dset, &pinfo->descriptor_sets)
+    for_array(lb, &dset->layout_bindings)
+    if (lb->descriptorCount != 0)
+        binding_count++;
+
+    spirv_blob_header header{};
+    header.magic = SPIRV_BLOB_MAGIC;
+    header.version = SPIRV_BLOB_VERSION;
+    header.pointer_size = (u8)sizeof(void*);
+    header.binding_size = (u8)sizeof(VkDescriptorSetLayoutBinding);
+    header.descriptor_set_count = (u32)pinfo->descriptor_sets.size;
+    header.binding_count = (u32)binding_count;
+    header.push_constant_count = (u32)pinfo->push_constants.size;
+    header.struct_count = (u32)structs.size;
+    header.member_count = (u32)members.size;
+    header.block_count = (u32)blocks.size;
+    header.strings_size = (u32)strings.size;
+
+    u64 offset = sizeof(spirv_blob_header);
+
+#define place(OFFSET, COUNT, TYPE)\
+    offset = align_up(offset, alignof(TYPE));\
+    header.OFFSET = (u32)offset;\
+    offset += (u64)(COUNT) * sizeof(TYPE);
+
+    place(descriptor_sets_offset, header.descriptor_set_count, spirv_blob_descriptor_set);
+    place(bindings_offset,        header.binding_count,        VkDescriptorSetLayoutBinding);
+    place(binding_flags_offset,   header.binding_count,        VkDescriptorBindingFlags);
+    place(push_constants_offset,  header.push_constant_count,  VkPushConstantRange);
+    place(structs_offset,         header.struct_count,         spirv_blob_struct);
+    place(members_offset,         header.member_count,         spirv_blob_member);
+    place(blocks_offset,          header.block_count,          spirv_blob_block);
+    place(strings_offset,         header.strings_size,         char);
+
+#undef place
+
+    offset = align_up(offset, 8);
+
+    if (offset > max_value(u32))
+    {
+        get_spirv_blob_error(err, "reflection of %lu bytes is too large", offset);
+        return false;
+    }
+
+    header.size = (u32)offset;
+
+    ::open(out, offset);
+    u8 *data = (u8*)out->data;
+    ::fill_memory(data, 0, offset);
+    ::copy_memory(&header, data, sizeof(header));
+
+    spirv_blob_descriptor_set *sets = (spirv_blob_descriptor_set*)(data + header.descriptor_sets_offset);
+    VkDescriptorSetLayoutBinding *bindings = (VkDescriptorSetLayoutBinding*)(data + header.bindings_offset);
+    VkDescriptorBindingFlags *binding_flags = (VkDescriptorBindingFlags*)(data + header.binding_flags_offset);
+    u32 binding = 0;
+
+    for_array(i, dset, &pinfo->descriptor_sets)
+    {
+        sets[i].first_binding = binding;
+
+        for_array(j, lb, &dset->layout_bindings)
+        if (lb->descriptorCount != 0)
+        {
+            bindings[binding] = *lb;
+            bindings[binding].pImmutableSamplers = nullptr;
+            binding_flags[binding] = dset->binding_flags[j];
+            binding++;
+        }
+
+        sets[i].binding_count = binding - sets[i].first_binding;
+    }
+
+    if (pinfo->push_constants.size > 0)
+        ::copy_memory(pinfo->push_constants.data, data + header.push_constants_offset, pinfo->push_constants.size * sizeof(VkPushConstantRange));
+
+    if (structs.size > 0)
+        ::copy_memory(structs.data, data + header.structs_offset, structs.size * sizeof(spirv_blob_struct));
+
+    if (members.size > 0)
+        ::copy_memory(members.data, data + header.members_offset, members.size * sizeof(spirv_blob_member));
+
+    if (blocks.size > 0)
+        ::copy_memory(blocks.data, data + header.blocks_offset, blocks.size * sizeof(spirv_blob_block));
+
+    ::copy_memory(strings.data, data + header.strings_offset, strings.size);
+
+    return true;
+}
+
+bool write_spirv_blob_file(const char *path, spirv_info *info, const spirv_pipeline_info *pinfo, error *err)
+{
+    assert(path != nullptr);
+
+    memory_stream blob{};
+
+    if (!write_spirv_blob(info, pinfo, &blob, err))
+        return false;
+
+    defer { ::close(&blob); };
+
+    return write_spirv_blob_file(path, &blob, err);
+}
+
+bool write_spirv_blob_file(const char *path, const memory_stream *blob, error *err)
+{
+    assert(path != nullptr);
+    assert(blob != nullptr);
+
+    char tmp_path[1040];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%d.tmp", path, (int)_process_id());
+
+    FILE *f = fopen(tmp_path, "wb");
+
+    if (f == nullptr)
+    {
+        get_spirv_blob_error(err, "could not open %s for writing", tmp_path);
+        return false;
+    }
+
+    bool ok = fwrite(blob->data, 1, blob->size, f) == blob->size;
+    ok = (fclose(f) == 0) && ok;
+
+    if (ok)
+    {
+#if defined(_WIN32)
+        // rename does not replace existing files on windows
+        remove(path);
+#endif
+        ok = rename(tmp_path, path) == 0;
+    }
+
+    if (!ok)
+    {
+        remove(tmp_path);
+        get_spirv_blob_error(err, "could not write %s", path);
+        return false;
+    }
+
+    return true;
+}
+
+void init(spirv_blob *blob)
+{
+    assert(blob != nullptr);
+
+    blob->data = nullptr;
+    blob->header = nullptr;
+    ::init(&blob->mapping);
+    blob->memory = memory_stream{};
+}
+
+void free(spirv_blob *blob)
+{
+    if (blob == nullptr)
+        return;
+
+    if (blob->mapping.data != nullptr)
+        ::unmap_file(&blob->mapping);
+
+    if (blob->memory.data != nullptr)
+        ::close(&blob->memory);
+
+    blob->memory = memory_stream{};
+    blob->data = nullptr;
+    blob->header = nullptr;
+}
+
+static inline bool _table_fits(u32 offset, u32 count, u64 element_size, u64 alignment, u32 size)
+{
+    return offset % alignment == 0 && (u64)offset + (u64)count * element_size <= size;
+}
+
+bool open_spirv_blob(spirv_blob *blob, const void *data, u64 size, error *err)
+{
+    assert(blob != nullptr);
+    assert(data != nullptr);
+
+    if ((u64)data % 8 != 0)
+    {
+        get_spirv_blob_error(err, "reflection blob is not 8 byte aligned");
+        return false;
+    }
+
+    const spirv_blob_header *header = (const spirv_blob_header*)data;
+
+    if (size < sizeof(spirv_blob_header))
+    {
+        get_spirv_blob_error(err, "reflection blob too small");
+        return false;
+    }
+
+    if (header->magic != SPIRV_BLOB_MAGIC)
+    {
+        if (header->magic == SPIRV_BLOB_SWAPPED_MAGIC)
+        {
+            get_spirv_blob_error(err, "reflection blob was written with the opposite endianness");
+        }
+        else
+        {
+            get_spirv_blob_error(err, "invalid reflection blob magic %08x", header->magic);
+        }
+
+        return false;
+    }
+
+    if (header->version != SPIRV_BLOB_VERSION
+     || header->pointer_size != sizeof(void*)
+     || header->binding_size != sizeof(VkDescriptorSetLayoutBinding))
+    {
+        get_spirv_blob_error(err, "reflection blob version %u for %u byte pointers, expected %u for %u byte pointers",
+                             (u32)header->version, (u32)header->pointer_size, (u32)SPIRV_BLOB_VERSION, (u32)sizeof(void*));
+        return false;
+    }
+
+    u32 blob_size = header->size;
+
+    if (blob_size > size
+     || !_table_fits(header->descriptor_sets_offset, header->descriptor_set_count, sizeof(spirv_blob_descriptor_set), alignof(spirv_blob_descriptor_set), blob_size)
+     || !_table_fits(header->bindings_offset, header->binding_count, sizeof(VkDescriptorSetLayoutBinding), alignof(VkDescriptorSetLayoutBinding), blob_size)
+     || !_table_fits(header->binding_flags_offset, header->binding_count, sizeof(VkDescriptorBindingFlags), alignof(VkDescriptorBindingFlags), blob_size)
+     || !_table_fits(header->push_constants_offset, header->push_constant_count, sizeof(VkPushConstantRange), alignof(VkPushConstantRange), blob_size)
+     || !_table_fits(header->structs_offset, header->struct_count, sizeof(spirv_blob_struct), alignof(spirv_blob_struct), blob_size)
+     || !_table_fits(header->members_offset, header->member_count, sizeof(spirv_blob_member), alignof(spirv_blob_member), blob_size)
+     || !_table_fits(header->blocks_offset, header->block_count, sizeof(spirv_blob_block), alignof(spirv_blob_block), blob_size)
+     || !_table_fits(header->strings_offset, header->strings_size, 1, 1, blob_size)
+     || header->strings_size == 0
+     || ((const char*)data)[header->strings_offset + header->strings_size - 1] != '\0')
+    {
+        get_spirv_blob_error(err, "reflection blob tables exceed its size of %u bytes", blob_size);
+        return false;
+    }
+
+    // indices between the tables, so the accessors need no checks
+    const u8 *bytes = (const u8*)data;
+    const spirv_blob_descriptor_set *sets = (const spirv_blob_descriptor_set*)(bytes + header->descriptor_sets_offset);
+    const spirv_blob_struct *structs = (const spirv_blob_struct*)(bytes + header->structs_offset);
+    const spirv_blob_member *members = (const spirv_blob_member*)(bytes + header->members_offset);
+    const spirv_blob_block *blocks = (const spirv_blob_block*)(bytes + header->blocks_offset);
+    bool ok = true;
+
+    for (u32 i = 0; i < header->descriptor_set_count; ++i)
+        ok = ok && (u64)sets[i].first_binding + sets[i].binding_count <= header->binding_count;
+
+    for (u32 i = 0; i < header->struct_count; ++i)
+        ok = ok && structs[i].name < header->strings_size
+                && (u64)structs[i].first_member + structs[i].member_count <= header->member_count;
+
+    for (u32 i = 0; i < header->member_count; ++i)
+        ok = ok && members[i].name < header->strings_size
+                && (members[i].struct_index < header->struct_count || members[i].struct_index == NO_INDEX);
+
+    for (u32 i = 0; i < header->block_count; ++i)
+        ok = ok && blocks[i].name < header->strings_size
+                && blocks[i].struct_index < header->struct_count;
+
+    if (!ok)
+    {
+        get_spirv_blob_error(err, "reflection blob contains an index out of range");
+        return false;
+    }
+
+    blob->data = bytes;
+    blob->header = header;
+
+    return true;
+}
+
+bool open_spirv_blob_file(spirv_blob *blob, const char *path, error *err)
+{
+    assert(blob != nullptr);
+    assert(path != nullptr);
+
+    if (!::map_file(&blob->mapping, path, spirv_mmap_advice_willneed, err))
+        return false;
+
+    if (!open_spirv_blob(blob, blob->mapping.data, blob->mapping.size, err))
+    {
+        ::unmap_file(&blob->mapping);
+        return false;
+    }
+
+    return true;
+}
+
+const VkDescriptorSetLayoutBinding *get_set_bindings(const spirv_blob *blob, u32 set, u32 *count)
+{
+    assert(count != nullptr);
+
+    if (set >= blob->header->descriptor_set_count)
+    {
+        *count = 0;
+        return nullptr;
+    }
+
+    const spirv_blob_descriptor_set *dset = (const spirv_blob_descriptor_set*)(blob->data + blob->header->descriptor_sets_offset) + set;
+    *count = dset->binding_count;
+
+    return (const VkDescriptorSetLayoutBinding*)(blob->data + blob->header->bindings_offset) + dset->first_binding;
+}
+
+const VkDescriptorBindingFlags *get_set_binding_flags(const spirv_blob *blob, u32 set, u32 *count)
+{
+    assert(count != nullptr);
+
+    if (set >= blob->header->descriptor_set_count)
+    {
+        *count = 0;
+        return nullptr;
+    }
+
+    const spirv_blob_descriptor_set *dset = (const spirv_blob_descriptor_set*)(blob->data + blob->header->descriptor_sets_offset) + set;
+    *count = dset->binding_count;
+
+    return (const VkDescriptorBindingFlags*)(blob->data + blob->header->binding_flags_offset) + dset->first_binding;
+}
+
+const VkPushConstantRange *get_push_constant_ranges(const spirv_blob *blob, u32 *count)
+{
+    assert(count != nullptr);
+
+    *count = blob->header->push_constant_count;
+    return (const VkPushConstantRange*)(blob->data + blob->header->push_constants_offset);
+}
+
+const spirv_blob_struct *get_structs(const spirv_blob *blob, u32 *count)
+{
+    assert(count != nullptr);
+
+    *count = blob->header->struct_count;
+    return (const spirv_blob_struct*)(blob->data + blob->header->structs_offset);
+}
+
+const spirv_blob_member *get_members(const spirv_blob *blob, const spirv_blob_struct *st, u32 *count)
+{
+    assert(st != nullptr);
+    assert(count != nullptr);
+
+    *count = st->member_count;
+    return (const spirv_blob_member*)(blob->data + blob->header->members_offset) + st->first_member;
+}
+
+const spirv_blob_block *get_blocks(const spirv_blob *blob, u32 *count)
+{
+    assert(count != nullptr);
+
+    *count = blob->header->block_count;
+    return (const spirv_blob_block*)(blob->data + blob->header->blocks_offset);
+}
+
+const char *get_string(const spirv_blob *blob, u32 offset)
+{
+    return (const char*)blob->data + blob->header->strings_offset + offset;
+}
+
+const spirv_blob_block *find_block(const spirv_blob *blob, u32 set, u32 binding)
+{
+    u32 count = 0;
+    const spirv_blob_block *blocks = get_blocks(blob, &count);
+
+    for (u32 i = 0; i < count; ++i)
+        if (blocks[i].set == set && blocks[i].binding == binding)
+            return blocks + i;
+
+    return nullptr;
+}
+
+void get_pipeline_info(spirv_pipeline_info *out, const spirv_blob *blob)
+{
+    assert(out != nullptr);
+    assert(blob != nullptr);
+
+    ::resize(&out->descriptor_sets, blob->header->descriptor_set_count);
+
+    for_array(dset, &out->descriptor_sets)
+        ::init(dset);
+
+    for_array(set, dset, &out->descriptor_sets)
+    {
+        u32 count = 0;
+        const VkDescriptorSetLayoutBinding *bindings = get_set_bindings(blob, (u32)set, &count);
+        const VkDescriptorBindingFlags *binding_flags = get_set_binding_flags(blob, (u32)set, &count);
+
+        if (count == 0)
+            continue;
+
+        // bindings are stored in ascending order, the last one is the highest
+        u64 size = (u64)bindings[count - 1].binding + 1;
+
+        ::resize(&dset->layout_bindings, size);
+        ::resize(&dset->binding_flags, size);
+        ::fill_memory(dset->layout_bindings.data, 0, size);
+        ::fill_memory(dset->binding_flags.data, 0, size);
+
+        for (u32 i = 0; i < count; ++i)
+        {
+            u32 binding = bindings[i].binding;
+
+            if (binding >= size)
+                continue;
+
+            dset->layout_bindings[binding] = bindings[i];
+            dset->binding_flags[binding] = binding_flags[i];
+        }
+    }
+
+    u32 push_constant_count = 0;
+    const VkPushConstantRange *push_constants = get_push_constant_ranges(blob, &push_constant_count);
+
+    ::resize(&out->push_constants, push_constant_count);
+
+    if (push_constant_count > 0)
+        ::copy_memory(push_constants, out->push_constants.data, push_constant_count * sizeof(VkPushConstantRange));
+}
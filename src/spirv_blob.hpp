@@ -0,0 +1,134 @@
+#pragma once
+
+#include "spirv_parser.hpp"
+
+// compact binary reflection format.
+// holds what the pipeline info and the struct layouts of a module
+// describe, laid out so that it can be used straight from a file mapping:
+// all references are offsets or indices, nothing is fixed up or
+// allocated when it is opened.
+// blobs are written in native endianness for the pointer size of the
+// writer, since bindings are stored as VkDescriptorSetLayoutBinding.
+// other blobs are rejected when opened.
+
+#define SPIRV_BLOB_MAGIC 0x42525053 // "SPRB"
+
+// bump whenever the layout below changes
+#define SPIRV_BLOB_VERSION 2
+
+// layout of a blob, offsets are from the start of the blob:
+//   header
+//   descriptor sets, indexed by set number
+//   bindings of all sets (8 byte aligned), used bindings only
+//   binding flags, parallel to the bindings
+//   push constant ranges
+//   structs, members, blocks
+//   strings, zero-terminated
+struct spirv_blob_header
+{
+    u32 magic;
+    u16 version;
+    u8 pointer_size; // sizeof(void*) of the writer
+    u8 binding_size; // sizeof(VkDescriptorSetLayoutBinding) of the writer
+    u32 size; // of the whole blob
+
+    u32 descriptor_set_count;
+    u32 binding_count;
+    u32 push_constant_count;
+    u32 struct_count;
+    u32 member_count;
+    u32 block_count;
+    u32 strings_size;
+
+    u32 descriptor_sets_offset;
+    u32 bindings_offset;
+    u32 binding_flags_offset;
+    u32 push_constants_offset;
+    u32 structs_offset;
+    u32 members_offset;
+    u32 blocks_offset;
+    u32 strings_offset;
+};
+
+struct spirv_blob_descriptor_set
+{
+    u32 first_binding; // index into the bindings
+    u32 binding_count;
+};
+
+// names are offsets into the strings, 0 is the empty string
+struct spirv_blob_struct
+{
+    u32 id; // result id of the OpTypeStruct
+    u32 name;
+    u32 size;
+    u32 alignment;
+    u32 first_member; // index into the members
+    u32 member_count;
+};
+
+struct spirv_blob_member
+{
+    u32 name;
+    u32 offset;
+    u32 size;
+    u32 struct_index; // of the member type if it is a struct, max_value(u32) otherwise
+};
+
+// uniform, storage buffer or push constant block variable
+struct spirv_blob_block
+{
+    u32 name; // of the variable
+    u32 storage_class; // SpvStorageClass
+    u32 set; // max_value(u32) for push constants
+    u32 binding;
+    u32 struct_index; // of the block type, arrays of blocks are resolved to their element
+};
+
+// serializes the reflection of info, and its pipeline info pinfo, into out.
+// out must be closed by the caller.
+bool write_spirv_blob(spirv_info *info, const spirv_pipeline_info *pinfo, memory_stream *out, error *err);
+// writes to a temporary file first and renames it, like the cache.
+bool write_spirv_blob_file(const char *path, spirv_info *info, const spirv_pipeline_info *pinfo, error *err);
+// writes a blob already serialized by write_spirv_blob.
+bool write_spirv_blob_file(const char *path, const memory_stream *blob, error *err);
+
+struct spirv_blob
+{
+    const u8 *data;
+    const spirv_blob_header *header;
+
+    // set by open_spirv_blob_file, released by free
+    spirv_file_mapping mapping;
+
+    // blob memory owned by the blob, e.g. from get_reflection_cached,
+    // closed by free
+    memory_stream memory;
+};
+
+void init(spirv_blob *blob);
+void free(spirv_blob *blob);
+
+// checks the header and that every table lies within size, data must be
+// 8 byte aligned and outlive the blob. nothing is copied.
+bool open_spirv_blob(spirv_blob *blob, const void *data, u64 size, error *err);
+// maps the file and opens the blob in the mapping.
+bool open_spirv_blob_file(spirv_blob *blob, const char *path, error *err);
+
+// direct access into the blob, valid until the blob is freed.
+// the bindings of a set are ready for VkDescriptorSetLayoutCreateInfo.
+const VkDescriptorSetLayoutBinding *get_set_bindings(const spirv_blob *blob, u32 set, u32 *count);
+// parallel to get_set_bindings, for VkDescriptorSetLayoutBindingFlagsCreateInfo.
+const VkDescriptorBindingFlags *get_set_binding_flags(const spirv_blob *blob, u32 set, u32 *count);
+const VkPushConstantRange *get_push_constant_ranges(const spirv_blob *blob, u32 *count);
+const spirv_blob_struct *get_structs(const spirv_blob *blob, u32 *count);
+const spirv_blob_member *get_members(const spirv_blob *blob, const spirv_blob_struct *st, u32 *count);
+const spirv_blob_block *get_blocks(const spirv_blob *blob, u32 *count);
+const char *get_string(const spirv_blob *blob, u32 offset);
+
+// the block at set / binding, nullptr if there is none.
+const spirv_blob_block *find_block(const spirv_blob *blob, u32 set, u32 binding);
+
+// fills out from the sets and push constant ranges of the blob, with
+// layout_bindings indexed by binding number again. out must be initialized.
+void get_pipeline_info(spirv_pipeline_info *out, const spirv_blob *blob);
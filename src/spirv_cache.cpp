@@ -0,0 +1,224 @@
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <direct.h>
+#define _make_directory(PATH) _mkdir(PATH)
+#else
+#include <sys/stat.h>
+#define _make_directory(PATH) mkdir(PATH, 0755)
+#endif
+
+#include "shl/defer.hpp"
+#include "spirv_cache.hpp"
+
+#define HASH_P1 0x9e3779b185ebca87ull
+#define HASH_P2 0xc2b2ae3d27d4eb4full
+
+static inline u64 _rotl(u64 x, u32 r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline u64 _avalanche(u64 h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+
+    return h;
+}
+
+u64 hash_spirv_module(const void *data, u64 size)
+{
+    const u8 *p = (const u8*)data;
+    u64 h = HASH_P1 ^ (size * HASH_P2);
+
+    u64 i = 0;
+
+    for (; i + 8 <= size; i += 8)
+    {
+        u64 v;
+        memcpy(&v, p + i, sizeof(u64));
+        h = _rotl(h ^ (v * HASH_P2), 31) * HASH_P1;
+    }
+
+    // modules are word aligned, at most one u32 is left
+    for (; i < size; ++i)
+        h = (h ^ p[i]) * HASH_P1;
+
+    return _avalanche(h);
+}
+
+u64 get_spirv_cache_key(const void *data, u64 size, const spirv_parse_options *options)
+{
+    spirv_layout_rules rules = options != nullptr ? options->layout_rules : spirv_layout_rules_std430;
+
+    return _avalanche(hash_spirv_module(data, size) ^ (((u64)rules + 1) * HASH_P2));
+}
+
+void init(spirv_reflection_cache *cache, const char *directory)
+{
+    assert(cache != nullptr);
+    assert(directory != nullptr);
+
+    cache->directory = directory;
+}
+
+static void _entry_path(const spirv_reflection_cache *cache, u64 key, char *out, u64 out_size)
+{
+    snprintf(out, out_size, "%s/%016llx-%u.spvr", cache->directory, (unsigned long long)key, (u32)SPIRV_PARSER_VERSION_TAG);
+}
+
+bool load_cached_pipeline_info(const spirv_reflection_cache *cache, u64 key, spirv_pipeline_info *out)
+{
+    assert(out != nullptr);
+
+    spirv_blob blob{};
+    ::init(&blob);
+    defer { ::free(&blob); };
+
+    if (!load_cached_reflection(cache, key, &blob))
+        return false;
+
+    get_pipeline_info(out, &blob);
+
+    return true;
+}
+
+bool load_cached_reflection(const spirv_reflection_cache *cache, u64 key, spirv_blob *out)
+{
+    assert(cache != nullptr);
+    assert(out != nullptr);
+
+    char path[1024];
+    _entry_path(cache, key, path, sizeof(path));
+
+    // a missing entry is not an error. entries with another blob version
+    // or pointer size fail to open and are overwritten by the next store.
+    return open_spirv_blob_file(out, path, nullptr);
+}
+
+static bool _store_blob(const spirv_reflection_cache *cache, u64 key, const memory_stream *blob, error *err)
+{
+    // fails if it exists, which is fine
+    _make_directory(cache->directory);
+
+    char path[1024];
+    _entry_path(cache, key, path, sizeof(path));
+
+    return write_spirv_blob_file(path, blob, err);
+}
+
+bool store_cached_reflection(const spirv_reflection_cache *cache, u64 key, spirv_info *info, const spirv_pipeline_info *pinfo, error *err)
+{
+    assert(cache != nullptr);
+    assert(info != nullptr);
+    assert(pinfo != nullptr);
+
+    memory_stream blob{};
+
+    if (!write_spirv_blob(info, pinfo, &blob, err))
+        return false;
+
+    defer { ::close(&blob); };
+
+    return _store_blob(cache, key, &blob, err);
+}
+
+// parses and reflects module on a miss
+static bool _reflect(memory_stream *module, spirv_info *info, spirv_pipeline_info *pinfo, error *err, const spirv_parse_options *options)
+{
+    module->position = 0;
+
+    if (!parse_spirv_from_memory(module, info, err, options))
+        return false;
+
+    get_pipeline_info(pinfo, info, options != nullptr ? &options->trace : nullptr);
+
+    return true;
+}
+
+bool get_pipeline_info_cached(const spirv_reflection_cache *cache, memory_stream *module, spirv_pipeline_info *out, error *err, const spirv_parse_options *options, bool *hit)
+{
+    assert(cache != nullptr);
+    assert(module != nullptr);
+    assert(out != nullptr);
+
+    u64 key = get_spirv_cache_key(module->data, module->size, options);
+
+    if (load_cached_pipeline_info(cache, key, out))
+    {
+        if (hit != nullptr)
+            *hit = true;
+
+        return true;
+    }
+
+    if (hit != nullptr)
+        *hit = false;
+
+    spirv_info info{};
+    ::init(&info);
+
+    // the module is borrowed, see parse_spirv_from_memory
+    defer { ::free(&info); };
+
+    if (!_reflect(module, &info, out, err, options))
+        return false;
+
+    // a failed store only costs the next run a parse
+    store_cached_reflection(cache, key, &info, out, nullptr);
+
+    return true;
+}
+
+bool get_reflection_cached(const spirv_reflection_cache *cache, memory_stream *module, spirv_blob *out, error *err, const spirv_parse_options *options, bool *hit)
+{
+    assert(cache != nullptr);
+    assert(module != nullptr);
+    assert(out != nullptr);
+
+    u64 key = get_spirv_cache_key(module->data, module->size, options);
+
+    if (load_cached_reflection(cache, key, out))
+    {
+        if (hit != nullptr)
+            *hit = true;
+
+        return true;
+    }
+
+    if (hit != nullptr)
+        *hit = false;
+
+    spirv_info info{};
+    ::init(&info);
+
+    spirv_pipeline_info pinfo{};
+    ::init(&pinfo);
+
+    defer
+    {
+        ::free(&info);
+        ::free(&pinfo);
+    };
+
+    if (!_reflect(module, &info, &pinfo, err, options))
+        return false;
+
+    // the blob keeps the serialized memory, the store does not need to succeed
+    if (!write_spirv_blob(&info, &pinfo, &out->memory, err))
+        return false;
+
+    if (!open_spirv_blob(out, out->memory.data, out->memory.size, err))
+        return false;
+
+    _store_blob(cache, key, &out->memory, nullptr);
+
+    return true;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "spirv_parser.hpp"
+#include "spirv_blob.hpp"
+
+// on-disk cache of reflection results.
+// entries are keyed by a hash of the module words and the parse options
+// that change the results, and stored as reflection blobs (see
+// spirv_blob.hpp) with the descriptor sets, push constant ranges and
+// struct layouts, so a hit never looks at the SPIR-V.
+// like blobs, entries are in native endianness and only valid for
+// the pointer size of the writer, others are treated as misses.
+
+// bump whenever the reflection output or the entry format changes,
+// entries with a different tag are ignored.
+// 4: entries are reflection blobs, keyed with the layout rules
+// 5: descriptors used by called functions before SPIR-V 1.4
+// 6: row major matrix members aligned to their row vectors
+// 7: push constant ranges of a stage combined into one range
+// 8: sizes of matrix members with their own stride or major-ness
+#define SPIRV_PARSER_VERSION_TAG 8
+
+// fast, non-cryptographic 64 bit hash of a module
+u64 hash_spirv_module(const void *data, u64 size);
+
+// the key of a module parsed with options, which may be nullptr.
+// the module hash with spirv_parse_options::layout_rules mixed in, the
+// other options do not change the results.
+u64 get_spirv_cache_key(const void *data, u64 size, const spirv_parse_options *options = nullptr);
+
+struct spirv_reflection_cache
+{
+    const char *directory; // not copied, must outlive the cache
+};
+
+void init(spirv_reflection_cache *cache, const char *directory);
+
+// returns false on a miss or if the entry is invalid.
+// out must be initialized.
+bool load_cached_pipeline_info(const spirv_reflection_cache *cache, u64 key, spirv_pipeline_info *out);
+// maps the entry and opens it as blob, out must be initialized and is
+// freed by the caller.
+bool load_cached_reflection(const spirv_reflection_cache *cache, u64 key, spirv_blob *out);
+
+// writes the reflection of info to a temporary file first and renames it,
+// readers never see half-written entries. creates the directory if necessary.
+bool store_cached_reflection(const spirv_reflection_cache *cache, u64 key, spirv_info *info, const spirv_pipeline_info *pinfo, error *err);
+
+// loads the pipeline info of the module from the cache, or parses and
+// reflects it on a miss and stores the result.
+// module is only read, its position is reset.
+// hit is set to whether the result came from the cache, may be nullptr.
+// options may be nullptr.
+bool get_pipeline_info_cached(const spirv_reflection_cache *cache, memory_stream *module, spirv_pipeline_info *out, error *err, const spirv_parse_options *options = nullptr, bool *hit = nullptr);
+
+// like get_pipeline_info_cached, but out is the whole reflection
+// including the struct layouts. out must be initialized and is freed
+// by the caller.
+bool get_reflection_cached(const spirv_reflection_cache *cache, memory_stream *module, spirv_blob *out, error *err, const spirv_parse_options *options = nullptr, bool *hit = nullptr);
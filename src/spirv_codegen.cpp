@@ -0,0 +1,577 @@
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <process.h>
+#define _process_id() _getpid()
+#else
+#include <unistd.h>
+#define _process_id() getpid()
+#endif
+
+#include "shl/memory.hpp"
+#include "shl/string.hpp"
+#include "shl/defer.hpp"
+#include "spirv_codegen.hpp"
+#include "spirv_update_template.hpp"
+
+#define get_spirv_codegen_error(ERR, FMT, ...) \
+    if (ERR != nullptr) { *ERR = error{.what = format_error(FMT __VA_OPT__(,) __VA_ARGS__), .file = __FILE__, .line = __LINE__}; }
+
+#define MAX_IDENTIFIER_LENGTH 256
+
+static void _append(array<char> *out, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    char buf[512];
+    int length = vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+
+    if (length <= 0)
+        return;
+
+    u64 start = out->size;
+    ::resize(out, start + (u64)length);
+
+    if ((u64)length < sizeof(buf))
+    {
+        ::copy_memory(buf, out->data + start, (u64)length);
+        return;
+    }
+
+    // longer than the buffer, format again into out. vsnprintf always
+    // writes the terminating zero, which ends up past size.
+    ::reserve(out, out->size + 1);
+    va_start(args, format);
+    vsnprintf(out->data + start, (u64)length + 1, format, args);
+    va_end(args);
+}
+
+static bool _is_identifier_char(char c)
+{
+    return (c >= 'a' && c <= 'z')
+        || (c >= 'A' && c <= 'Z')
+        || (c >= '0' && c <= '9')
+        || c == '_';
+}
+
+// C++20 keywords and alternative tokens, none of them can be a name
+static const char *_keywords[] = {
+    "alignas", "alignof", "and", "and_eq", "asm", "auto", "bitand", "bitor",
+    "bool", "break", "case", "catch", "char", "char8_t", "char16_t",
+    "char32_t", "class", "compl", "concept", "const", "consteval",
+    "constexpr", "constinit", "const_cast", "continue", "co_await",
+    "co_return", "co_yield", "decltype", "default", "delete", "do", "double",
+    "dynamic_cast", "else", "enum", "explicit", "export", "extern", "false",
+    "float", "for", "friend", "goto", "if", "inline", "int", "long",
+    "mutable", "namespace", "new", "noexcept", "not", "not_eq", "nullptr",
+    "operator", "or", "or_eq", "private", "protected", "public", "register",
+    "reinterpret_cast", "requires", "return", "short", "signed", "sizeof",
+    "static", "static_assert", "static_cast", "struct", "switch", "template",
+    "this", "thread_local", "throw", "true", "try", "typedef", "typeid",
+    "typename", "union", "unsigned", "using", "virtual", "void", "volatile",
+    "wchar_t", "while", "xor", "xor_eq"
+};
+
+// length characters of str
+static bool _is_keyword(const char *str, u64 length)
+{
+    for (const char *keyword : _keywords)
+        if (string_length(keyword) == length && strncmp(keyword, str, length) == 0)
+            return true;
+
+    return false;
+}
+
+void to_identifier(const char *str, char *out, u64 size)
+{
+    assert(out != nullptr);
+    assert(size >= 2);
+
+    u64 i = 0;
+
+    if (str == nullptr || str[0] == '\0' || (str[0] >= '0' && str[0] <= '9'))
+        out[i++] = '_';
+
+    if (str != nullptr)
+    for (; *str != '\0' && i < size - 1; ++str)
+        out[i++] = _is_identifier_char(*str) ? *str : '_';
+
+    // keywords get a trailing underscore, e.g. "default_"
+    if (_is_keyword(out, i))
+    {
+        if (i < size - 1)
+            i++;
+
+        out[i - 1] = '_';
+    }
+
+    out[i] = '\0';
+}
+
+// identifiers separated by "::", keywords are not identifiers
+static bool _is_valid_namespace(const char *name_space)
+{
+    const char *c = name_space;
+
+    while (true)
+    {
+        if (!_is_identifier_char(*c) || (*c >= '0' && *c <= '9'))
+            return false;
+
+        const char *start = c;
+
+        while (_is_identifier_char(*c))
+            ++c;
+
+        if (_is_keyword(start, (u64)(c - start)))
+            return false;
+
+        if (*c == '\0')
+            return true;
+
+        if (c[0] != ':' || c[1] != ':')
+            return false;
+
+        c += 2;
+    }
+}
+
+static void _append_stage_flags(array<char> *out, VkShaderStageFlags stages)
+{
+    static const struct { VkShaderStageFlags bit; const char *name; } _stages[] = {
+        {VK_SHADER_STAGE_VERTEX_BIT,                  "VK_SHADER_STAGE_VERTEX_BIT"},
+        {VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT,    "VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT"},
+        {VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT, "VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT"},
+        {VK_SHADER_STAGE_GEOMETRY_BIT,                "VK_SHADER_STAGE_GEOMETRY_BIT"},
+        {VK_SHADER_STAGE_FRAGMENT_BIT,                "VK_SHADER_STAGE_FRAGMENT_BIT"},
+        {VK_SHADER_STAGE_COMPUTE_BIT,                 "VK_SHADER_STAGE_COMPUTE_BIT"},
+    };
+
+    if (stages == 0)
+    {
+        _append(out, "0");
+        return;
+    }
+
+    const char *separator = "";
+
+    for (const auto &stage : _stages)
+    {
+        if ((stages & stage.bit) == 0)
+            continue;
+
+        _append(out, "%s%s", separator, stage.name);
+        separator = " | ";
+        stages &= ~stage.bit;
+    }
+
+    if (stages != 0)
+        _append(out, "%s0x%xu", separator, stages);
+}
+
+static void _append_binding_flags(array<char> *out, VkDescriptorBindingFlags flags)
+{
+    static const struct { VkDescriptorBindingFlags bit; const char *name; } _flags[] = {
+        {VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT,           "VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT"},
+        {VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT, "VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT"},
+        {VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT,             "VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT"},
+        {VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT,   "VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT"},
+    };
+
+    if (flags == 0)
+    {
+        _append(out, "0");
+        return;
+    }
+
+    const char *separator = "";
+
+    for (const auto &flag : _flags)
+    {
+        if ((flags & flag.bit) == 0)
+            continue;
+
+        _append(out, "%s%s", separator, flag.name);
+        separator = " | ";
+        flags &= ~flag.bit;
+    }
+
+    if (flags != 0)
+        _append(out, "%s0x%xu", separator, flags);
+}
+
+static void _append_descriptor_type(array<char> *out, VkDescriptorType type)
+{
+#define DESCRIPTOR_TYPE_CASE(TYPE)\
+    case TYPE: _append(out, #TYPE); return;
+
+    switch (type)
+    {
+    DESCRIPTOR_TYPE_CASE(VK_DESCRIPTOR_TYPE_SAMPLER);
+    DESCRIPTOR_TYPE_CASE(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    DESCRIPTOR_TYPE_CASE(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE);
+    DESCRIPTOR_TYPE_CASE(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+    DESCRIPTOR_TYPE_CASE(VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER);
+    DESCRIPTOR_TYPE_CASE(VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER);
+    DESCRIPTOR_TYPE_CASE(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+    DESCRIPTOR_TYPE_CASE(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+    DESCRIPTOR_TYPE_CASE(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
+    DESCRIPTOR_TYPE_CASE(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC);
+    DESCRIPTOR_TYPE_CASE(VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT);
+    DESCRIPTOR_TYPE_CASE(VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR);
+    default: _append(out, "(VkDescriptorType)%d", (int)type); return;
+    }
+
+#undef DESCRIPTOR_TYPE_CASE
+}
+
+// the host-side type of one descriptor in update template data
+static const char *_update_data_type_name(VkDescriptorType type)
+{
+    switch (type)
+    {
+    case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+    case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+    case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+    case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+        return "VkDescriptorBufferInfo";
+
+    case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+    case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+        return "VkBufferView";
+
+    case VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR:
+        return "VkAccelerationStructureKHR";
+
+    default:
+        return "VkDescriptorImageInfo";
+    }
+}
+
+// names are kept in one buffer, offsets index into it
+static bool _name_taken(const array<char> *names, const array<u32> *offsets, u64 first, const char *name)
+{
+    for (u64 i = first; i < offsets->size; ++i)
+        if (compare_strings(names->data + offsets->data[i], name) == 0)
+            return true;
+
+    return false;
+}
+
+static u32 _add_name(array<char> *names, const char *name)
+{
+    u32 offset = (u32)names->size;
+    u64 length = string_length(name);
+
+    for (u64 i = 0; i <= length; ++i)
+        ::add_at_end(names, name[i]);
+
+    return offset;
+}
+
+// shared by every generated header, so headers of several shaders can be
+// included together.
+static const char *_common_types = R"=(#ifndef SPIRV_CODEGEN_TYPES
+#define SPIRV_CODEGEN_TYPES
+struct spirv_codegen_descriptor_set
+{
+    const VkDescriptorSetLayoutBinding *bindings; // nullptr if the set has no used bindings
+    const VkDescriptorBindingFlags *binding_flags; // nullptr if no binding has flags
+    uint32_t binding_count;
+};
+
+struct spirv_codegen_member
+{
+    const char *name;
+    uint32_t offset;
+    uint32_t size;
+};
+#endif
+)=";
+
+bool generate_pipeline_header(spirv_info *info, const spirv_pipeline_info *pinfo, const char *name_space, array<char> *out, error *err)
+{
+    assert(info != nullptr);
+    assert(pinfo != nullptr);
+    assert(name_space != nullptr);
+    assert(out != nullptr);
+
+    if (!_is_valid_namespace(name_space))
+    {
+        get_spirv_codegen_error(err, "'%s' is not a valid namespace", name_space);
+        return false;
+    }
+
+    _append(out, "// generated by spirv-parser (codegen version %d), do not edit\n", SPIRV_CODEGEN_VERSION);
+    _append(out, "#pragma once\n\n#include <stddef.h>\n#include <stdint.h>\n#include <vulkan/vulkan_core.h>\n\n");
+    _append(out, "%s\n", _common_types);
+    _append(out, "namespace %s\n{\n", name_space);
+
+    // descriptor sets, unused bindings have no descriptors and are left out
+    for_array(i, dset, &pinfo->descriptor_sets)
+    {
+        bool used = false;
+
+        for_array(lb, &dset->layout_bindings)
+            used = used || lb->descriptorCount != 0;
+
+        if (!used)
+            continue;
+
+        _append(out, "inline constexpr VkDescriptorSetLayoutBinding set%lu_bindings[] = {\n", i);
+
+        for_array(lb, &dset->layout_bindings)
+        {
+            if (lb->descriptorCount == 0)
+                continue;
+
+            _append(out, "    {.binding = %u, .descriptorType = ", lb->binding);
+            _append_descriptor_type(out, lb->descriptorType);
+            _append(out, ", .descriptorCount = %u, .stageFlags = ", lb->descriptorCount);
+            _append_stage_flags(out, lb->stageFlags);
+            _append(out, ", .pImmutableSamplers = nullptr},\n");
+        }
+
+        _append(out, "};\n\n");
+
+        bool flags = false;
+
+        for_array(f, &dset->binding_flags)
+            flags = flags || *f != 0;
+
+        if (!flags)
+            continue;
+
+        // for VkDescriptorSetLayoutBindingFlagsCreateInfo
+        _append(out, "inline constexpr VkDescriptorBindingFlags set%lu_binding_flags[] = {\n", i);
+
+        for_array(j, lb, &dset->layout_bindings)
+        {
+            if (lb->descriptorCount == 0)
+                continue;
+
+            _append(out, "    ");
+            _append_binding_flags(out, dset->binding_flags[j]);
+            _append(out, ",\n");
+        }
+
+        _append(out, "};\n\n");
+    }
+
+    _append(out, "inline constexpr uint32_t descriptor_set_count = %lu;\n", pinfo->descriptor_sets.size);
+
+    if (pinfo->descriptor_sets.size > 0)
+    {
+        _append(out, "inline constexpr spirv_codegen_descriptor_set descriptor_sets[] = {\n");
+
+        for_array(i, dset, &pinfo->descriptor_sets)
+        {
+            u32 count = 0;
+            bool flags = false;
+
+            for_array(j, lb, &dset->layout_bindings)
+            if (lb->descriptorCount != 0)
+            {
+                count++;
+                flags = flags || dset->binding_flags[j] != 0;
+            }
+
+            if (count == 0)
+                _append(out, "    {nullptr, nullptr, 0},\n");
+            else if (!flags)
+                _append(out, "    {set%lu_bindings, nullptr, %u},\n", i, count);
+            else
+                _append(out, "    {set%lu_bindings, set%lu_binding_flags, %u},\n", i, i, count);
+        }
+
+        _append(out, "};\n");
+    }
+
+    // update templates, the data struct uses the sizes of the compiler
+    // that includes the header, not those of the generator.
+    spirv_update_template tmpl{};
+    init(&tmpl);
+    defer { free(&tmpl); };
+
+    for_array(i, dset, &pinfo->descriptor_sets)
+    {
+        get_update_template(dset, &tmpl);
+
+        if (tmpl.entries.size == 0)
+            continue;
+
+        _append(out, "\n// for vkUpdateDescriptorSetWithTemplate\nstruct set%lu_update_data\n{\n", i);
+
+        for_array(entry, &tmpl.entries)
+            _append(out, "    %s binding%u[%u];\n", _update_data_type_name(entry->descriptorType), entry->dstBinding, entry->descriptorCount);
+
+        _append(out, "};\n\ninline constexpr VkDescriptorUpdateTemplateEntry set%lu_update_entries[] = {\n", i);
+
+        for_array(entry, &tmpl.entries)
+        {
+            _append(out, "    {.dstBinding = %u, .dstArrayElement = 0, .descriptorCount = %u, .descriptorType = ", entry->dstBinding, entry->descriptorCount);
+            _append_descriptor_type(out, entry->descriptorType);
+            _append(out, ", .offset = offsetof(set%lu_update_data, binding%u), .stride = sizeof(%s)},\n",
+                    i, entry->dstBinding, _update_data_type_name(entry->descriptorType));
+        }
+
+        _append(out, "};\n");
+    }
+
+    _append(out, "\ninline constexpr uint32_t push_constant_range_count = %lu;\n", pinfo->push_constants.size);
+
+    if (pinfo->push_constants.size > 0)
+    {
+        _append(out, "inline constexpr VkPushConstantRange push_constant_ranges[] = {\n");
+
+        for_array(pc, &pinfo->push_constants)
+        {
+            _append(out, "    {.stageFlags = ");
+            _append_stage_flags(out, pc->stageFlags);
+            _append(out, ", .offset = %u, .size = %u},\n", pc->offset, pc->size);
+        }
+
+        _append(out, "};\n");
+    }
+
+    // struct layouts in declaration order. unnamed or clashing structs and
+    // members get their id or index appended.
+    array<char> names{};
+    array<u32> struct_names{};
+    array<u32> member_names{};
+
+    defer
+    {
+        ::free(&names);
+        ::free(&struct_names);
+        ::free(&member_names);
+    };
+
+    char name[MAX_IDENTIFIER_LENGTH];
+
+    for_array(t, &info->types)
+    {
+        if (t->instruction.opcode != SpvOpTypeStruct)
+            continue;
+
+        const char *type_name = get_id_name(info, t->id);
+
+        if (type_name == nullptr || type_name[0] == '\0')
+            snprintf(name, sizeof(name), "struct_%u", t->id);
+        else
+            to_identifier(type_name, name, sizeof(name));
+
+        if (_name_taken(&names, &struct_names, 0, name))
+        {
+            u64 length = string_length(name);
+            snprintf(name + length, sizeof(name) - length, "_%u", t->id);
+        }
+
+        ::add_at_end(&struct_names, _add_name(&names, name));
+
+        _append(out, "\nstruct %s_layout\n{\n", name);
+        _append(out, "    static constexpr uint32_t size = %lu;\n", t->size);
+        _append(out, "    static constexpr uint32_t alignment = %u;\n", t->alignment);
+        _append(out, "    static constexpr uint32_t member_count = %lu;\n", t->members.size);
+
+        if (t->members.size == 0)
+        {
+            _append(out, "};\n");
+            continue;
+        }
+
+        ::clear(&member_names);
+
+        _append(out, "    static constexpr spirv_codegen_member members[] = {\n");
+
+        for_array(m, mem, &t->members)
+        {
+            if (mem->name == nullptr || mem->name[0] == '\0')
+                snprintf(name, sizeof(name), "member%lu", m);
+            else
+                to_identifier(mem->name, name, sizeof(name));
+
+            if (_name_taken(&names, &member_names, 0, name))
+            {
+                u64 length = string_length(name);
+                snprintf(name + length, sizeof(name) - length, "_%lu", m);
+            }
+
+            ::add_at_end(&member_names, _add_name(&names, name));
+
+            _append(out, "        {\"%s\", %lu, %lu},\n", name, mem->offset, mem->size);
+        }
+
+        _append(out, "    };\n\n");
+
+        for_array(m, mem, &t->members)
+            _append(out, "    static constexpr uint32_t offset_%s = %lu;\n", names.data + member_names[m], mem->offset);
+
+        _append(out, "};\n");
+    }
+
+    _append(out, "}\n");
+
+    return true;
+}
+
+bool write_pipeline_header_file(const char *path, spirv_info *info, const spirv_pipeline_info *pinfo, const char *name_space, error *err)
+{
+    assert(path != nullptr);
+
+    array<char> header{};
+    defer { ::free(&header); };
+
+    if (!generate_pipeline_header(info, pinfo, name_space, &header, err))
+        return false;
+
+    spirv_file_mapping existing{};
+    ::init(&existing);
+
+    if (::map_file(&existing, path, spirv_mmap_advice_none, nullptr))
+    {
+        bool same = existing.size == header.size
+                 && memcmp(existing.data, header.data, header.size) == 0;
+
+        ::unmap_file(&existing);
+
+        if (same)
+            return true;
+    }
+
+    char tmp_path[1040];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%d.tmp", path, (int)_process_id());
+
+    FILE *f = fopen(tmp_path, "wb");
+
+    if (f == nullptr)
+    {
+        get_spirv_codegen_error(err, "could not open %s for writing", tmp_path);
+        return false;
+    }
+
+    bool ok = fwrite(header.data, 1, header.size, f) == header.size;
+    ok = (fclose(f) == 0) && ok;
+
+    if (ok)
+    {
+#if defined(_WIN32)
+        // rename does not replace existing files on windows
+        remove(path);
+#endif
+        ok = rename(tmp_path, path) == 0;
+    }
+
+    if (!ok)
+    {
+        remove(tmp_path);
+        get_spirv_codegen_error(err, "could not write %s", path);
+        return false;
+    }
+
+    return true;
+}
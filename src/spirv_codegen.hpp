@@ -0,0 +1,37 @@
+#pragma once
+
+#include "spirv_parser.hpp"
+
+// generates a C++20 header from the reflection of a module, so pipeline
+// layouts can be built without parsing the module at runtime.
+// the header contains, in a namespace:
+//   set<N>_bindings        constexpr VkDescriptorSetLayoutBinding arrays,
+//                          used bindings only
+//   set<N>_binding_flags   constexpr VkDescriptorBindingFlags arrays, parallel
+//                          to the bindings, only for sets with flags
+//   descriptor_sets        {bindings, binding_flags, binding_count} per set number
+//   set<N>_update_data     host-side struct of the descriptors of a set and
+//   set<N>_update_entries  its VkDescriptorUpdateTemplateEntry array, see
+//                          spirv_update_template.hpp
+//   push_constant_ranges   constexpr VkPushConstantRange array
+//   <struct>_layout        size, alignment and member offsets of every struct
+// the output only depends on the module and the namespace, so the same
+// module always generates the same header.
+
+// bump whenever the generated code changes
+#define SPIRV_CODEGEN_VERSION 4
+
+// name_space may be nested, e.g. "shaders::lighting", and must not
+// contain C++ keywords.
+// the header is appended to out, which is not zero-terminated.
+bool generate_pipeline_header(spirv_info *info, const spirv_pipeline_info *pinfo, const char *name_space, array<char> *out, error *err);
+
+// writes to a temporary file first and renames it. an existing file with
+// the same content is left untouched, so build systems do not rebuild
+// anything that includes it.
+bool write_pipeline_header_file(const char *path, spirv_info *info, const spirv_pipeline_info *pinfo, const char *name_space, error *err);
+
+// turns str into an identifier, e.g. for a namespace from a file name.
+// C++ keywords get a trailing underscore, e.g. "default_".
+// writes at most size bytes including the terminating zero.
+void to_identifier(const char *str, char *out, u64 size);
@@ -0,0 +1,437 @@
+
+#include <assert.h>
+
+#include "shl/memory.hpp"
+#include "shl/defer.hpp"
+#include "spirv_layout_registry.hpp"
+
+#define HASH_K 0x9e3779b97f4a7c15ull
+
+// splitmix64 finalizer
+static inline u64 _mix(u64 x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+}
+
+struct _binding
+{
+    VkDescriptorSetLayoutBinding layout;
+    VkDescriptorBindingFlags flags;
+};
+
+static inline VkDescriptorBindingFlags _binding_flags(const spirv_descriptor_set *dset, u64 i)
+{
+    // sets filled by hand may have no flags
+    return i < dset->binding_flags.size ? dset->binding_flags[i] : 0;
+}
+
+static inline u64 _hash_binding(const VkDescriptorSetLayoutBinding *lb, VkDescriptorBindingFlags flags)
+{
+    u64 a = (u64)lb->binding | ((u64)(u32)lb->descriptorType << 32);
+    u64 b = (u64)lb->descriptorCount | ((u64)lb->stageFlags << 32);
+
+    return _mix(_mix(_mix(a) + b) + flags);
+}
+
+static inline u64 _hash_push_constant_range(const VkPushConstantRange *pc)
+{
+    return _mix(_mix((u64)pc->stageFlags | ((u64)pc->offset << 32)) + pc->size);
+}
+
+// bindings are combined by addition, which does not depend on their order
+u64 hash_descriptor_set(const spirv_descriptor_set *dset)
+{
+    assert(dset != nullptr);
+
+    u64 sum = 0;
+    u64 count = 0;
+
+    for_array(i, lb, &dset->layout_bindings)
+    if (lb->descriptorCount != 0)
+    {
+        sum += _hash_binding(lb, _binding_flags(dset, i));
+        count++;
+    }
+
+    return _mix(sum + count * HASH_K);
+}
+
+u64 hash_pipeline_layout(const spirv_pipeline_info *info)
+{
+    assert(info != nullptr);
+
+    u64 h = _mix(info->descriptor_sets.size);
+
+    for_array(dset, &info->descriptor_sets)
+        h = _mix(h + hash_descriptor_set(dset));
+
+    u64 sum = 0;
+
+    for_array(pc, &info->push_constants)
+        sum += _hash_push_constant_range(pc);
+
+    return _mix(h ^ (sum + info->push_constants.size * HASH_K));
+}
+
+// the used bindings of dset sorted by binding number. layout_bindings
+// is usually indexed by binding already, so this is one pass.
+static void _canonical_bindings(const spirv_descriptor_set *dset, array<_binding> *out)
+{
+    ::clear(out);
+
+    for_array(i, lb, &dset->layout_bindings)
+    {
+        if (lb->descriptorCount == 0)
+            continue;
+
+        _binding b;
+        b.layout = *lb;
+        b.layout.pImmutableSamplers = nullptr;
+        b.flags = _binding_flags(dset, i);
+
+        u64 j = out->size;
+        ::add_at_end(out);
+
+        for (; j > 0 && out->data[j - 1].layout.binding > b.layout.binding; --j)
+            out->data[j] = out->data[j - 1];
+
+        out->data[j] = b;
+    }
+}
+
+static inline bool _bindings_equal(const VkDescriptorSetLayoutBinding *a, VkDescriptorBindingFlags a_flags,
+                                   const VkDescriptorSetLayoutBinding *b, VkDescriptorBindingFlags b_flags)
+{
+    return a->binding == b->binding
+        && a->descriptorType == b->descriptorType
+        && a->descriptorCount == b->descriptorCount
+        && a->stageFlags == b->stageFlags
+        && a_flags == b_flags;
+}
+
+bool descriptor_sets_equal(const spirv_descriptor_set *a, const spirv_descriptor_set *b)
+{
+    assert(a != nullptr);
+    assert(b != nullptr);
+
+    array<_binding> ca{};
+    array<_binding> cb{};
+
+    defer
+    {
+        ::free(&ca);
+        ::free(&cb);
+    };
+
+    _canonical_bindings(a, &ca);
+    _canonical_bindings(b, &cb);
+
+    if (ca.size != cb.size)
+        return false;
+
+    for (u64 i = 0; i < ca.size; ++i)
+        if (!_bindings_equal(&ca[i].layout, ca[i].flags, &cb[i].layout, cb[i].flags))
+            return false;
+
+    return true;
+}
+
+static bool _push_constant_ranges_equal(const VkPushConstantRange *a, const VkPushConstantRange *b)
+{
+    return a->stageFlags == b->stageFlags && a->offset == b->offset && a->size == b->size;
+}
+
+void init(spirv_layout_registry *registry)
+{
+    assert(registry != nullptr);
+
+    ::init(&registry->sets);
+    ::init(&registry->bindings);
+    ::init(&registry->binding_flags);
+    ::init(&registry->pipelines);
+    ::init(&registry->pipeline_set_ids);
+    ::init(&registry->push_constants);
+    ::init(&registry->set_table);
+    ::init(&registry->pipeline_table);
+}
+
+void free(spirv_layout_registry *registry)
+{
+    if (registry == nullptr)
+        return;
+
+    ::free(&registry->sets);
+    ::free(&registry->bindings);
+    ::free(&registry->binding_flags);
+    ::free(&registry->pipelines);
+    ::free(&registry->pipeline_set_ids);
+    ::free(&registry->push_constants);
+    ::free(&registry->set_table);
+    ::free(&registry->pipeline_table);
+}
+
+spirv_layout_registry *get_global_layout_registry()
+{
+    static spirv_layout_registry registry;
+    static std::once_flag once;
+
+    std::call_once(once, [] { init(&registry); });
+
+    return &registry;
+}
+
+// keeps the table at most half full, rehashing from the entries
+static void _grow_table(array<u32> *table, const array<spirv_registered_layout> *entries)
+{
+    if ((entries->size + 1) * 2 <= table->size)
+        return;
+
+    u64 size = table->size == 0 ? 64 : table->size * 2;
+    ::resize(table, size);
+    ::fill_memory(table->data, 0xff, size);
+
+    for_array(i, entry, entries)
+    {
+        u64 slot = entry->hash & (size - 1);
+
+        while (table->data[slot] != SPIRV_INVALID_LAYOUT_ID)
+            slot = (slot + 1) & (size - 1);
+
+        table->data[slot] = (u32)i;
+    }
+}
+
+// the first slot with id SPIRV_INVALID_LAYOUT_ID or an entry for which
+// equal returns true.
+template<typename F>
+static u64 _find_slot(const array<u32> *table, const array<spirv_registered_layout> *entries, u64 hash, F equal)
+{
+    u64 mask = table->size - 1;
+    u64 slot = hash & mask;
+
+    while (true)
+    {
+        u32 id = table->data[slot];
+
+        if (id == SPIRV_INVALID_LAYOUT_ID)
+            return slot;
+
+        const spirv_registered_layout *entry = entries->data + id;
+
+        if (entry->hash == hash && equal(entry))
+            return slot;
+
+        slot = (slot + 1) & mask;
+    }
+}
+
+// registry->mutex must be held
+static u32 _register_descriptor_set(spirv_layout_registry *registry, const array<_binding> *canonical, u64 hash, bool *inserted)
+{
+    _grow_table(&registry->set_table, &registry->sets);
+
+    u64 slot = _find_slot(&registry->set_table, &registry->sets, hash, [registry, canonical](const spirv_registered_layout *entry)
+    {
+        if (entry->count != canonical->size)
+            return false;
+
+        for (u32 i = 0; i < entry->count; ++i)
+        {
+            u32 b = entry->first + i;
+
+            if (!_bindings_equal(registry->bindings.data + b, registry->binding_flags[b], &canonical->data[i].layout, canonical->data[i].flags))
+                return false;
+        }
+
+        return true;
+    });
+
+    u32 id = registry->set_table[slot];
+
+    if (id != SPIRV_INVALID_LAYOUT_ID)
+    {
+        *inserted = false;
+        return id;
+    }
+
+    id = (u32)registry->sets.size;
+
+    spirv_registered_layout *entry = ::add_at_end(&registry->sets);
+    entry->hash = hash;
+    entry->first = (u32)registry->bindings.size;
+    entry->count = (u32)canonical->size;
+    entry->first_push_constant = 0;
+    entry->push_constant_count = 0;
+
+    for_array(b, canonical)
+    {
+        ::add_at_end(&registry->bindings, b->layout);
+        ::add_at_end(&registry->binding_flags, b->flags);
+    }
+
+    registry->set_table[slot] = id;
+    *inserted = true;
+
+    return id;
+}
+
+u32 register_descriptor_set(spirv_layout_registry *registry, const spirv_descriptor_set *dset, bool *inserted)
+{
+    assert(registry != nullptr);
+    assert(dset != nullptr);
+
+    bool _inserted;
+
+    if (inserted == nullptr)
+        inserted = &_inserted;
+
+    // everything but the table lookup happens outside of the lock
+    array<_binding> canonical{};
+    defer { ::free(&canonical); };
+
+    _canonical_bindings(dset, &canonical);
+    u64 hash = hash_descriptor_set(dset);
+
+    std::lock_guard<std::mutex> lock(registry->mutex);
+
+    return _register_descriptor_set(registry, &canonical, hash, inserted);
+}
+
+u32 register_pipeline_layout(spirv_layout_registry *registry, const spirv_pipeline_info *info, u32 *set_ids, bool *inserted)
+{
+    assert(registry != nullptr);
+    assert(info != nullptr);
+
+    bool _inserted;
+
+    if (inserted == nullptr)
+        inserted = &_inserted;
+
+    u64 set_count = info->descriptor_sets.size;
+
+    array<array<_binding>> canonical{};
+    array<u64> set_hashes{};
+    array<u32> ids{};
+    array<VkPushConstantRange> ranges{};
+
+    defer
+    {
+        ::free<true>(&canonical);
+        ::free(&set_hashes);
+        ::free(&ids);
+        ::free(&ranges);
+    };
+
+    ::resize(&canonical, set_count);
+    ::resize(&set_hashes, set_count);
+    ::resize(&ids, set_count);
+
+    for_array(i, dset, &info->descriptor_sets)
+    {
+        ::init(canonical.data + i);
+        _canonical_bindings(dset, canonical.data + i);
+        set_hashes[i] = hash_descriptor_set(dset);
+    }
+
+    // ranges sorted by offset, size and stages
+    for_array(pc, &info->push_constants)
+    {
+        u64 j = ranges.size;
+        ::add_at_end(&ranges, *pc);
+
+        for (; j > 0; --j)
+        {
+            const VkPushConstantRange *prev = ranges.data + j - 1;
+
+            if (prev->offset < pc->offset
+             || (prev->offset == pc->offset && (prev->size < pc->size
+              || (prev->size == pc->size && prev->stageFlags <= pc->stageFlags))))
+                break;
+
+            ranges[j] = *prev;
+        }
+
+        ranges[j] = *pc;
+    }
+
+    u64 hash = hash_pipeline_layout(info);
+
+    std::lock_guard<std::mutex> lock(registry->mutex);
+
+    for (u64 i = 0; i < set_count; ++i)
+    {
+        bool set_inserted;
+        ids[i] = _register_descriptor_set(registry, canonical.data + i, set_hashes[i], &set_inserted);
+    }
+
+    if (set_ids != nullptr && set_count > 0)
+        ::copy_memory(ids.data, set_ids, set_count * sizeof(u32));
+
+    _grow_table(&registry->pipeline_table, &registry->pipelines);
+
+    // equal sets have equal ids, so pipelines compare by set ids
+    u64 slot = _find_slot(&registry->pipeline_table, &registry->pipelines, hash, [registry, &ids, &ranges](const spirv_registered_layout *entry)
+    {
+        if (entry->count != ids.size || entry->push_constant_count != ranges.size)
+            return false;
+
+        for (u32 i = 0; i < entry->count; ++i)
+            if (registry->pipeline_set_ids[entry->first + i] != ids[i])
+                return false;
+
+        for (u32 i = 0; i < entry->push_constant_count; ++i)
+            if (!_push_constant_ranges_equal(registry->push_constants.data + entry->first_push_constant + i, ranges.data + i))
+                return false;
+
+        return true;
+    });
+
+    u32 id = registry->pipeline_table[slot];
+
+    if (id != SPIRV_INVALID_LAYOUT_ID)
+    {
+        *inserted = false;
+        return id;
+    }
+
+    id = (u32)registry->pipelines.size;
+
+    spirv_registered_layout *entry = ::add_at_end(&registry->pipelines);
+    entry->hash = hash;
+    entry->first = (u32)registry->pipeline_set_ids.size;
+    entry->count = (u32)ids.size;
+    entry->first_push_constant = (u32)registry->push_constants.size;
+    entry->push_constant_count = (u32)ranges.size;
+
+    for_array(set_id, &ids)
+        ::add_at_end(&registry->pipeline_set_ids, *set_id);
+
+    for_array(pc, &ranges)
+        ::add_at_end(&registry->push_constants, *pc);
+
+    registry->pipeline_table[slot] = id;
+    *inserted = true;
+
+    return id;
+}
+
+u32 get_descriptor_set_count(spirv_layout_registry *registry)
+{
+    assert(registry != nullptr);
+
+    std::lock_guard<std::mutex> lock(registry->mutex);
+    return (u32)registry->sets.size;
+}
+
+u32 get_pipeline_layout_count(spirv_layout_registry *registry)
+{
+    assert(registry != nullptr);
+
+    std::lock_guard<std::mutex> lock(registry->mutex);
+    return (u32)registry->pipelines.size;
+}
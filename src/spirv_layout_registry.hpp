@@ -0,0 +1,74 @@
+#pragma once
+
+#include <mutex>
+
+#include "spirv_parser.hpp"
+
+// canonical hashes of reflected layouts and a registry that interns
+// equal layouts, so pipelines with the same set layouts can share
+// VkDescriptorSetLayouts, pipeline layouts and descriptor pools.
+
+// hash of the used bindings of a set: binding number, descriptor type,
+// count, stage flags and binding flags. unused bindings and the order of
+// the bindings do not change the hash.
+u64 hash_descriptor_set(const spirv_descriptor_set *dset);
+
+// hash of the descriptor sets, by set number, and of the push constant
+// ranges in any order.
+u64 hash_pipeline_layout(const spirv_pipeline_info *info);
+
+// whether the used bindings of a and b are the same
+bool descriptor_sets_equal(const spirv_descriptor_set *a, const spirv_descriptor_set *b);
+
+#define SPIRV_INVALID_LAYOUT_ID max_value(u32)
+
+struct spirv_registered_layout
+{
+    u64 hash;
+    u32 first; // index into bindings for sets, into pipeline_set_ids for pipelines
+    u32 count;
+    u32 first_push_constant; // pipelines only
+    u32 push_constant_count;
+};
+
+// interns descriptor set layouts and pipeline layouts. ids are small,
+// dense (from 0, per kind) and never change, so they can index arrays of
+// Vulkan objects. registering is thread-safe.
+struct spirv_layout_registry
+{
+    std::mutex mutex;
+
+    // set layouts, their used bindings sorted by binding number
+    array<spirv_registered_layout> sets;
+    array<VkDescriptorSetLayoutBinding> bindings;
+    array<VkDescriptorBindingFlags> binding_flags;
+
+    // pipeline layouts, set layout ids by set number and push constant
+    // ranges sorted by offset
+    array<spirv_registered_layout> pipelines;
+    array<u32> pipeline_set_ids;
+    array<VkPushConstantRange> push_constants;
+
+    // open addressing, ids or SPIRV_INVALID_LAYOUT_ID. size is a power of two.
+    array<u32> set_table;
+    array<u32> pipeline_table;
+};
+
+void init(spirv_layout_registry *registry);
+void free(spirv_layout_registry *registry);
+
+// the registry shared by the whole process, initialized on first use and
+// never freed.
+spirv_layout_registry *get_global_layout_registry();
+
+// returns the id of the set layout equal to dset, registering it if there
+// is none yet, in which case inserted is set.
+u32 register_descriptor_set(spirv_layout_registry *registry, const spirv_descriptor_set *dset, bool *inserted = nullptr);
+
+// registers every set of info and the pipeline layout made of those sets
+// and the push constant ranges of info. set_ids, if not nullptr, receives
+// the set layout id of each set of info.
+u32 register_pipeline_layout(spirv_layout_registry *registry, const spirv_pipeline_info *info, u32 *set_ids = nullptr, bool *inserted = nullptr);
+
+u32 get_descriptor_set_count(spirv_layout_registry *registry);
+u32 get_pipeline_layout_count(spirv_layout_registry *registry);
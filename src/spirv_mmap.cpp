@@ -0,0 +1,143 @@
+
+#include <assert.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "spirv_mmap.hpp"
+
+#define get_spirv_mmap_error(ERR, FMT, ...) \
+    if (ERR != nullptr) { *ERR = error{.what = format_error(FMT __VA_OPT__(,) __VA_ARGS__), .file = __FILE__, .line = __LINE__}; }
+
+void init(spirv_file_mapping *mapping)
+{
+    assert(mapping != nullptr);
+
+    mapping->data = nullptr;
+    mapping->size = 0;
+}
+
+#if defined(_WIN32)
+bool map_file(spirv_file_mapping *mapping, const char *path, u8 advice, error *err)
+{
+    assert(mapping != nullptr);
+    assert(path != nullptr);
+
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        get_spirv_mmap_error(err, "could not open file %s", path);
+        return false;
+    }
+
+    LARGE_INTEGER size;
+
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(file);
+        get_spirv_mmap_error(err, "could not get size of %s or file is empty", path);
+        return false;
+    }
+
+    HANDLE map = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+
+    if (map == nullptr)
+    {
+        get_spirv_mmap_error(err, "could not map file %s", path);
+        return false;
+    }
+
+    void *data = MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(map);
+
+    if (data == nullptr)
+    {
+        get_spirv_mmap_error(err, "could not map file %s", path);
+        return false;
+    }
+
+    // no equivalent for sequential / willneed hints worth the trouble here
+    (void)advice;
+
+    mapping->data = data;
+    mapping->size = (u64)size.QuadPart;
+
+    return true;
+}
+
+void unmap_file(spirv_file_mapping *mapping)
+{
+    assert(mapping != nullptr);
+
+    if (mapping->data != nullptr)
+        UnmapViewOfFile(mapping->data);
+
+    mapping->data = nullptr;
+    mapping->size = 0;
+}
+#else
+bool map_file(spirv_file_mapping *mapping, const char *path, u8 advice, error *err)
+{
+    assert(mapping != nullptr);
+    assert(path != nullptr);
+
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0)
+    {
+        get_spirv_mmap_error(err, "could not open file %s", path);
+        return false;
+    }
+
+    struct stat st;
+
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close(fd);
+        get_spirv_mmap_error(err, "could not get size of %s or file is empty", path);
+        return false;
+    }
+
+    void *data = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // the mapping keeps its own reference to the file
+    close(fd);
+
+    if (data == MAP_FAILED)
+    {
+        get_spirv_mmap_error(err, "could not map file %s", path);
+        return false;
+    }
+
+    // hints only, failure is not an error
+    if (advice & spirv_mmap_advice_sequential)
+        madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+    if (advice & spirv_mmap_advice_willneed)
+        madvise(data, (size_t)st.st_size, MADV_WILLNEED);
+
+    mapping->data = data;
+    mapping->size = (u64)st.st_size;
+
+    return true;
+}
+
+void unmap_file(spirv_file_mapping *mapping)
+{
+    assert(mapping != nullptr);
+
+    if (mapping->data != nullptr)
+        munmap(mapping->data, (size_t)mapping->size);
+
+    mapping->data = nullptr;
+    mapping->size = 0;
+}
+#endif
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "shl/number_types.hpp"
+#include "shl/error.hpp"
+
+// read-only, private file mapping. parsed instructions and names can
+// point straight into the mapping instead of a heap copy of the file.
+enum spirv_mmap_advice : u8
+{
+    spirv_mmap_advice_none       = 0,
+    spirv_mmap_advice_sequential = 1 << 0, // MADV_SEQUENTIAL
+    spirv_mmap_advice_willneed   = 1 << 1  // MADV_WILLNEED
+};
+
+struct spirv_file_mapping
+{
+    void *data;
+    u64 size;
+};
+
+void init(spirv_file_mapping *mapping);
+
+// returns false and sets err if the file could not be mapped.
+bool map_file(spirv_file_mapping *mapping, const char *path, u8 advice, error *err);
+void unmap_file(spirv_file_mapping *mapping);
@@ -0,0 +1,212 @@
+#pragma once
+
+#include "shl/number_types.hpp"
+#include "spirv1_2.h"
+
+// compile-time table of the opcodes the parser handles, indexed by opcode.
+// gives the logical layout section of an instruction, where its result id
+// is and how many words it has at least.
+// https://registry.khronos.org/SPIR-V/specs/unified1/SPIRV.html#_logical_layout_of_a_module
+
+enum spirv_section : u8
+{
+    spirv_section_capability,
+    spirv_section_extension,
+    spirv_section_ext_inst_import,
+    spirv_section_memory_model,
+    spirv_section_entry_point,
+    spirv_section_execution_mode,
+    spirv_section_debug_source,     // OpString, OpSource*
+    spirv_section_debug_name,       // OpName, OpMemberName
+    spirv_section_module_processed,
+    spirv_section_annotation,
+    spirv_section_types,            // types, constants, global variables
+    spirv_section_function,         // function declarations and bodies
+    spirv_section_any               // OpLine / OpNoLine, allowed almost anywhere
+};
+
+enum spirv_opcode_flags : u8
+{
+    spirv_opcode_flag_none           = 0,
+    spirv_opcode_flag_result_type    = 1 << 0, // words[1] is the result type
+    spirv_opcode_flag_type           = 1 << 1, // type declaration
+    spirv_opcode_flag_value          = 1 << 2, // constant or variable, stored in spirv_info::variables
+    spirv_opcode_flag_known          = 1 << 3, // listed below, the other fields are valid
+    spirv_opcode_flag_trailing_types = 1 << 4  // the trailing operands are types, not just ids
+};
+
+// trailing_word of instructions whose trailing ids follow a string operand
+#define SPIRV_AFTER_STRING 0xff
+
+// operand layout, used by the validating parse. bit n of id_words is set
+// if words[n] is an id (including result type and result id), bit n of
+// type_words if it must be the id of a type. all of them are below
+// min_word_count. trailing_word is the first of the optional ids that
+// run until the end of the instruction, 0 if there are none.
+struct spirv_opcode_info
+{
+    spirv_section section;
+    u8 flags;
+    u8 result_id_word; // index of the result id in words, 0 if there is none
+    u8 min_word_count; // including the opcode word
+    u8 id_words;
+    u8 type_words;
+    u8 trailing_word;
+    u8 string_word; // first word of a literal string operand, 0 if there is none
+};
+
+// SPIRV_OPCODE(opcode, section, has result type, is type, is value, result id word, min word count,
+//              id words, type words, trailing word, trailing kind, string word)
+#define SPIRV_OPCODES \
+    SPIRV_OPCODE(Capability,            capability,       0, 0, 0, 0, 2, 0,       0,       0,                  none,  0) \
+    SPIRV_OPCODE(Extension,             extension,        0, 0, 0, 0, 2, 0,       0,       0,                  none,  1) \
+    SPIRV_OPCODE(ExtInstImport,         ext_inst_import,  0, 0, 0, 1, 3, 0b10,    0,       0,                  none,  2) \
+    SPIRV_OPCODE(MemoryModel,           memory_model,     0, 0, 0, 0, 3, 0,       0,       0,                  none,  0) \
+    SPIRV_OPCODE(EntryPoint,            entry_point,      0, 0, 0, 0, 4, 0b100,   0,       SPIRV_AFTER_STRING, ids,   3) \
+    SPIRV_OPCODE(ExecutionMode,         execution_mode,   0, 0, 0, 0, 3, 0b10,    0,       0,                  none,  0) \
+    SPIRV_OPCODE(ExecutionModeId,       execution_mode,   0, 0, 0, 0, 3, 0b10,    0,       3,                  ids,   0) \
+    SPIRV_OPCODE(String,                debug_source,     0, 0, 0, 1, 3, 0b10,    0,       0,                  none,  2) \
+    SPIRV_OPCODE(Source,                debug_source,     0, 0, 0, 0, 3, 0,       0,       0,                  none,  0) \
+    SPIRV_OPCODE(SourceExtension,       debug_source,     0, 0, 0, 0, 2, 0,       0,       0,                  none,  1) \
+    SPIRV_OPCODE(SourceContinued,       debug_source,     0, 0, 0, 0, 2, 0,       0,       0,                  none,  1) \
+    SPIRV_OPCODE(Name,                  debug_name,       0, 0, 0, 0, 3, 0b10,    0,       0,                  none,  2) \
+    SPIRV_OPCODE(MemberName,            debug_name,       0, 0, 0, 0, 4, 0b10,    0,       0,                  none,  3) \
+    SPIRV_OPCODE(ModuleProcessed,       module_processed, 0, 0, 0, 0, 2, 0,       0,       0,                  none,  1) \
+    SPIRV_OPCODE(Decorate,              annotation,       0, 0, 0, 0, 3, 0b10,    0,       0,                  none,  0) \
+    SPIRV_OPCODE(MemberDecorate,        annotation,       0, 0, 0, 0, 4, 0b10,    0,       0,                  none,  0) \
+    SPIRV_OPCODE(DecorateId,            annotation,       0, 0, 0, 0, 3, 0b10,    0,       3,                  ids,   0) \
+    SPIRV_OPCODE(DecorationGroup,       annotation,       0, 0, 0, 1, 2, 0b10,    0,       0,                  none,  0) \
+    SPIRV_OPCODE(GroupDecorate,         annotation,       0, 0, 0, 0, 2, 0b10,    0,       2,                  ids,   0) \
+    SPIRV_OPCODE(GroupMemberDecorate,   annotation,       0, 0, 0, 0, 2, 0b10,    0,       0,                  none,  0) \
+    SPIRV_OPCODE(TypeVoid,              types,            0, 1, 0, 1, 2, 0b10,    0,       0,                  none,  0) \
+    SPIRV_OPCODE(TypeBool,              types,            0, 1, 0, 1, 2, 0b10,    0,       0,                  none,  0) \
+    SPIRV_OPCODE(TypeInt,               types,            0, 1, 0, 1, 4, 0b10,    0,       0,                  none,  0) \
+    SPIRV_OPCODE(TypeFloat,             types,            0, 1, 0, 1, 3, 0b10,    0,       0,                  none,  0) \
+    SPIRV_OPCODE(TypeVector,            types,            0, 1, 0, 1, 4, 0b110,   0b100,   0,                  none,  0) \
+    SPIRV_OPCODE(TypeMatrix,            types,            0, 1, 0, 1, 4, 0b110,   0b100,   0,                  none,  0) \
+    SPIRV_OPCODE(TypeImage,             types,            0, 1, 0, 1, 9, 0b110,   0b100,   0,                  none,  0) \
+    SPIRV_OPCODE(TypeSampler,           types,            0, 1, 0, 1, 2, 0b10,    0,       0,                  none,  0) \
+    SPIRV_OPCODE(TypeSampledImage,      types,            0, 1, 0, 1, 3, 0b110,   0b100,   0,                  none,  0) \
+    SPIRV_OPCODE(TypeArray,             types,            0, 1, 0, 1, 4, 0b1110,  0b100,   0,                  none,  0) \
+    SPIRV_OPCODE(TypeRuntimeArray,      types,            0, 1, 0, 1, 3, 0b110,   0b100,   0,                  none,  0) \
+    SPIRV_OPCODE(TypeStruct,            types,            0, 1, 0, 1, 2, 0b10,    0,       2,                  types, 0) \
+    SPIRV_OPCODE(TypeOpaque,            types,            0, 1, 0, 1, 3, 0b10,    0,       0,                  none,  2) \
+    SPIRV_OPCODE(TypePointer,           types,            0, 1, 0, 1, 4, 0b1010,  0b1000,  0,                  none,  0) \
+    SPIRV_OPCODE(TypeFunction,          types,            0, 1, 0, 1, 3, 0b110,   0b100,   3,                  types, 0) \
+    SPIRV_OPCODE(TypeEvent,             types,            0, 1, 0, 1, 2, 0b10,    0,       0,                  none,  0) \
+    SPIRV_OPCODE(TypeDeviceEvent,       types,            0, 1, 0, 1, 2, 0b10,    0,       0,                  none,  0) \
+    SPIRV_OPCODE(TypeReserveId,         types,            0, 1, 0, 1, 2, 0b10,    0,       0,                  none,  0) \
+    SPIRV_OPCODE(TypeQueue,             types,            0, 1, 0, 1, 2, 0b10,    0,       0,                  none,  0) \
+    SPIRV_OPCODE(TypePipe,              types,            0, 1, 0, 1, 3, 0b10,    0,       0,                  none,  0) \
+    SPIRV_OPCODE(TypePipeStorage,       types,            0, 1, 0, 1, 2, 0b10,    0,       0,                  none,  0) \
+    SPIRV_OPCODE(TypeNamedBarrier,      types,            0, 1, 0, 1, 2, 0b10,    0,       0,                  none,  0) \
+    SPIRV_OPCODE(TypeForwardPointer,    types,            0, 0, 0, 0, 3, 0b10,    0,       0,                  none,  0) \
+    SPIRV_OPCODE(ConstantTrue,          types,            1, 0, 1, 2, 3, 0b110,   0b10,    0,                  none,  0) \
+    SPIRV_OPCODE(ConstantFalse,         types,            1, 0, 1, 2, 3, 0b110,   0b10,    0,                  none,  0) \
+    SPIRV_OPCODE(Constant,              types,            1, 0, 1, 2, 4, 0b110,   0b10,    0,                  none,  0) \
+    SPIRV_OPCODE(ConstantComposite,     types,            1, 0, 1, 2, 3, 0b110,   0b10,    3,                  ids,   0) \
+    SPIRV_OPCODE(ConstantSampler,       types,            1, 0, 1, 2, 6, 0b110,   0b10,    0,                  none,  0) \
+    SPIRV_OPCODE(ConstantNull,          types,            1, 0, 1, 2, 3, 0b110,   0b10,    0,                  none,  0) \
+    SPIRV_OPCODE(SpecConstantTrue,      types,            1, 0, 1, 2, 3, 0b110,   0b10,    0,                  none,  0) \
+    SPIRV_OPCODE(SpecConstantFalse,     types,            1, 0, 1, 2, 3, 0b110,   0b10,    0,                  none,  0) \
+    SPIRV_OPCODE(SpecConstant,          types,            1, 0, 1, 2, 4, 0b110,   0b10,    0,                  none,  0) \
+    SPIRV_OPCODE(SpecConstantComposite, types,            1, 0, 1, 2, 3, 0b110,   0b10,    3,                  ids,   0) \
+    SPIRV_OPCODE(SpecConstantOp,        types,            1, 0, 1, 2, 4, 0b110,   0b10,    0,                  none,  0) \
+    SPIRV_OPCODE(Variable,              types,            1, 0, 1, 2, 4, 0b110,   0b10,    4,                  ids,   0) \
+    SPIRV_OPCODE(Undef,                 types,            1, 0, 0, 2, 3, 0b110,   0b10,    0,                  none,  0) \
+    SPIRV_OPCODE(Line,                  any,              0, 0, 0, 0, 4, 0b10,    0,       0,                  none,  0) \
+    SPIRV_OPCODE(NoLine,                any,              0, 0, 0, 0, 1, 0,       0,       0,                  none,  0) \
+    SPIRV_OPCODE(Function,              function,         1, 0, 0, 2, 5, 0b10110, 0b10010, 0,                  none,  0) \
+    SPIRV_OPCODE(FunctionParameter,     function,         1, 0, 0, 2, 3, 0b110,   0b10,    0,                  none,  0) \
+    SPIRV_OPCODE(FunctionEnd,           function,         0, 0, 0, 0, 1, 0,       0,       0,                  none,  0) \
+    SPIRV_OPCODE(FunctionCall,          function,         1, 0, 0, 2, 4, 0b1110,  0b10,    4,                  ids,   0) \
+    SPIRV_OPCODE(Label,                 function,         0, 0, 0, 1, 2, 0b10,    0,       0,                  none,  0) \
+    SPIRV_OPCODE(AccessChain,           function,         1, 0, 0, 2, 4, 0b1110,  0b10,    4,                  ids,   0) \
+    SPIRV_OPCODE(InBoundsAccessChain,   function,         1, 0, 0, 2, 4, 0b1110,  0b10,    4,                  ids,   0) \
+    SPIRV_OPCODE(Load,                  function,         1, 0, 0, 2, 4, 0b1110,  0b10,    0,                  none,  0) \
+    SPIRV_OPCODE(Store,                 function,         0, 0, 0, 0, 3, 0b110,   0,       0,                  none,  0) \
+    SPIRV_OPCODE(Return,                function,         0, 0, 0, 0, 1, 0,       0,       0,                  none,  0) \
+    SPIRV_OPCODE(ReturnValue,           function,         0, 0, 0, 0, 2, 0b10,    0,       0,                  none,  0)
+
+// core opcodes of SPIR-V 1.2, OpDecorateId is the highest
+#define SPIRV_OPCODE_TABLE_SIZE (SpvOpDecorateId + 1)
+
+struct spirv_opcode_table
+{
+    spirv_opcode_info entries[SPIRV_OPCODE_TABLE_SIZE];
+};
+
+// everything not listed can only appear in function bodies
+constexpr spirv_opcode_info spirv_unknown_opcode_info{spirv_section_function, spirv_opcode_flag_none, 0, 1, 0, 0, 0, 0};
+
+#define SPIRV_TRAILING_none  0
+#define SPIRV_TRAILING_ids   0
+#define SPIRV_TRAILING_types spirv_opcode_flag_trailing_types
+
+constexpr spirv_opcode_table _make_spirv_opcode_table()
+{
+    spirv_opcode_table table{};
+
+    for (spirv_opcode_info &e : table.entries)
+        e = spirv_unknown_opcode_info;
+
+#define SPIRV_OPCODE(OP, SECTION, RESULT_TYPE, TYPE, VALUE, RESULT_ID_WORD, MIN_WORDS, ID_WORDS, TYPE_WORDS, TRAILING_WORD, TRAILING, STRING_WORD) \
+    table.entries[SpvOp##OP] = spirv_opcode_info{\
+        .section = spirv_section_##SECTION,\
+        .flags = (u8)(spirv_opcode_flag_known\
+                    | (RESULT_TYPE ? spirv_opcode_flag_result_type : 0)\
+                    | (TYPE ? spirv_opcode_flag_type : 0)\
+                    | (VALUE ? spirv_opcode_flag_value : 0)\
+                    | (SPIRV_TRAILING_##TRAILING)),\
+        .result_id_word = RESULT_ID_WORD,\
+        .min_word_count = MIN_WORDS,\
+        .id_words = ID_WORDS,\
+        .type_words = TYPE_WORDS,\
+        .trailing_word = TRAILING_WORD,\
+        .string_word = STRING_WORD\
+    };
+
+    SPIRV_OPCODES
+
+#undef SPIRV_OPCODE
+
+    return table;
+}
+
+inline constexpr spirv_opcode_table spirv_opcode_infos = _make_spirv_opcode_table();
+
+static_assert(spirv_opcode_infos.entries[SpvOpTypeStruct].section == spirv_section_types);
+static_assert(spirv_opcode_infos.entries[SpvOpVariable].result_id_word == 2);
+static_assert(spirv_opcode_infos.entries[SpvOpIAdd].flags == spirv_opcode_flag_none);
+
+// fixed id operands can be read once the word count is checked
+constexpr bool _spirv_operands_within_min_word_count()
+{
+    for (const spirv_opcode_info &e : spirv_opcode_infos.entries)
+    {
+        if ((e.id_words | e.type_words) >> e.min_word_count)
+            return false;
+
+        // the validating parse only looks at words 1 to 4
+        if ((e.id_words | e.type_words) & ~0b11110)
+            return false;
+
+        if (e.result_id_word != 0 && !(e.id_words & (1 << e.result_id_word)))
+            return false;
+
+        if (e.string_word != 0 && e.string_word >= e.min_word_count)
+            return false;
+    }
+
+    return true;
+}
+
+static_assert(_spirv_operands_within_min_word_count());
+
+constexpr const spirv_opcode_info *get_spirv_opcode_info(u16 opcode)
+{
+    if (opcode < SPIRV_OPCODE_TABLE_SIZE)
+        return spirv_opcode_infos.entries + opcode;
+
+    return &spirv_unknown_opcode_info;
+}
@@ -1,11 +1,15 @@
 
 #include <stdio.h>
+#include <stdarg.h>
 #include <assert.h>
+#include <chrono>
 
 #include "shl/string.hpp"
 #include "shl/memory.hpp"
 #include "shl/defer.hpp"
 #include "spirv_parser.hpp"
+#include "spirv_opcodes.hpp"
+#include "spirv_swap.hpp"
 
 #define INSTR_FMT "[%lu]"
 #define INSTR_ID_FMT INSTR_FMT " %%%u ="
@@ -13,7 +17,154 @@
 #define get_spirv_parse_error(ERR, FMT, ...) \
     if (ERR != nullptr) { *ERR = error{.what = format_error(FMT __VA_OPT__(,) __VA_ARGS__), .file = __FILE__, .line = __LINE__}; }
 
-#define UNCALCULATED max_value(u32)
+// only the level check is done on the hot path, formatting happens
+// in the sink. with SPIRV_PARSER_TRACE 0 the whole call disappears.
+#if SPIRV_PARSER_TRACE
+#define spirv_trace_enabled(SINK, LEVEL) ((SINK)->level >= (LEVEL))
+#else
+#define spirv_trace_enabled(SINK, LEVEL) (false)
+#endif
+
+#define spirv_trace(SINK, LEVEL, FMT, ...) \
+    if (spirv_trace_enabled(SINK, LEVEL)) { _trace(SINK, FMT __VA_OPT__(,) __VA_ARGS__); }
+
+static void _trace(const spirv_trace_sink *sink, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    sink->trace(sink->context, format, args);
+    va_end(args);
+}
+
+static void _null_trace(void *, const char *, va_list)
+{
+}
+
+static void _file_trace(void *context, const char *format, va_list args)
+{
+    vfprintf((FILE*)context, format, args);
+}
+
+static const spirv_trace_sink _null_trace_sink{.trace = _null_trace, .context = nullptr, .level = spirv_trace_level_none};
+
+spirv_trace_sink spirv_null_trace_sink()
+{
+    return _null_trace_sink;
+}
+
+spirv_trace_sink spirv_disassembly_trace_sink(FILE *file, spirv_trace_level level)
+{
+    assert(file != nullptr);
+
+    return spirv_trace_sink{.trace = _file_trace, .context = file, .level = level};
+}
+
+void init(spirv_parse_options *options)
+{
+    assert(options != nullptr);
+
+    options->trace = spirv_null_trace_sink();
+    options->use_arena = false;
+    options->arena_block_size = SPIRV_ARENA_DEFAULT_BLOCK_SIZE;
+    options->use_mmap = false;
+    options->mmap_advice = spirv_mmap_advice_sequential;
+    options->layout_rules = spirv_layout_rules_std430;
+    options->validate = false;
+    options->stats = nullptr;
+}
+
+const char *spirv_parse_phase_name(spirv_parse_phase phase)
+{
+    switch (phase)
+    {
+    case spirv_parse_phase_header:                  return "header";
+    case spirv_parse_phase_mode_setting:            return "mode_setting";
+    case spirv_parse_phase_debug:                   return "debug";
+    case spirv_parse_phase_decorations:             return "decorations";
+    case spirv_parse_phase_types:                   return "types";
+    case spirv_parse_phase_member_fixups:           return "member_fixups";
+    case spirv_parse_phase_functions:               return "functions";
+    case spirv_parse_phase_function_information:    return "function_information";
+    case spirv_parse_phase_type_layouts:            return "type_layouts";
+    default: return "";
+    }
+}
+
+// the phase being measured, per thread so that the allocation helpers
+// and collect_function_information can count into it without passing
+// it around. nullptr unless spirv_parse_options::stats is set.
+static thread_local spirv_parse_phase_stats *_phase_stats = nullptr;
+
+static inline void _count_allocation(u64 bytes)
+{
+    spirv_parse_phase_stats *stats = _phase_stats;
+
+    if (stats == nullptr || bytes == 0)
+        return;
+
+    stats->allocations++;
+    stats->allocated_bytes += bytes;
+}
+
+static u64 _clock_ns()
+{
+    return (u64)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// measures consecutive phases. index and offset are the instruction
+// index and byte offset of the cursor, their difference between two
+// phases is what the earlier phase walked.
+struct _phase_clock
+{
+    spirv_parse_stats *stats;
+    spirv_parse_phase phase;
+    u64 parse_start_ns;
+    u64 start_ns;
+    u64 start_index;
+    u64 start_offset;
+};
+
+static void _start_phase_clock(_phase_clock *clock, spirv_parse_stats *stats)
+{
+    clock->stats = stats;
+
+    if (stats == nullptr)
+        return;
+
+    ::fill_memory(stats, 0);
+    clock->phase = spirv_parse_phase_header;
+    clock->parse_start_ns = clock->start_ns = _clock_ns();
+    clock->start_index = 0;
+    clock->start_offset = 0;
+    _phase_stats = stats->phases + spirv_parse_phase_header;
+}
+
+// ends the current phase and starts next, spirv_parse_phase_count ends
+// the last one.
+static void _next_phase(_phase_clock *clock, spirv_parse_phase next, u64 index, u64 offset)
+{
+    if (clock->stats == nullptr)
+        return;
+
+    u64 now = _clock_ns();
+    spirv_parse_phase_stats *current = clock->stats->phases + clock->phase;
+    current->ns += now - clock->start_ns;
+    current->instructions += index - clock->start_index;
+    current->bytes += offset - clock->start_offset;
+
+    clock->phase = next;
+    clock->start_ns = now;
+    clock->start_index = index;
+    clock->start_offset = offset;
+
+    if (next < spirv_parse_phase_count)
+        _phase_stats = clock->stats->phases + next;
+    else
+    {
+        clock->stats->total_ns = now - clock->parse_start_ns;
+        _phase_stats = nullptr;
+    }
+}
 
 bool next_instruction(memory_stream *stream, spirv_instruction *out)
 {
@@ -21,11 +172,9 @@ bool next_instruction(memory_stream *stream, spirv_instruction *out)
     u64 len = out->word_count * sizeof(u32);
     u64 offset = diff + len;
 
-    if (offset > stream->size)
+    if (offset + sizeof(u32) > stream->size)
         return false;
 
-    assert(stream->size - offset >= 4);
-
     out->words = (u32*)(stream->data + offset);
 
     read_at(stream, &out->opcode, offset);
@@ -35,15 +184,484 @@ bool next_instruction(memory_stream *stream, spirv_instruction *out)
     return true;
 }
 
-void init(spirv_id_instruction *instr)
+// forward cursor over the instructions of a module, reads one instruction
+// header at a time straight from the stream.
+struct spirv_instruction_cursor
+{
+    memory_stream *stream;
+    spirv_instruction instruction; // the current instruction
+    u64 index; // index of the current instruction in the module
+    bool valid; // false once the end of the stream is reached
+};
+
+static bool _read_instruction(memory_stream *stream, spirv_instruction *out)
+{
+    if (stream->position + sizeof(u32) > stream->size)
+        return false;
+
+    out->words = (u32*)::current(stream);
+    read(stream, &out->opcode);
+    read(stream, &out->word_count);
+
+    assert(out->word_count >= 1);
+    stream->position += sizeof(u32) * (out->word_count - 1);
+    return true;
+}
+
+void init(spirv_instruction_cursor *cur, memory_stream *stream)
+{
+    cur->stream = stream;
+    cur->index = 0;
+    cur->valid = _read_instruction(stream, &cur->instruction);
+}
+
+bool advance(spirv_instruction_cursor *cur)
+{
+    cur->index++;
+    cur->valid = _read_instruction(cur->stream, &cur->instruction);
+    return cur->valid;
+}
+
+// reserves exactly count elements, from the arena if the info uses one.
+// arena-backed containers must never grow past this.
+template<typename T>
+static void _reserve_exact(array<T> *arr, u64 count, spirv_info *info)
 {
-    ::init(&instr->decoration_indices);
-    instr->extra = max_value(u32);
+    _count_allocation(count * sizeof(T));
+
+    if (!info->use_arena)
+    {
+        ::reserve(arr, count);
+        return;
+    }
+
+    assert(arr->data == nullptr);
+    arr->data = allocate<T>(&info->arena, count);
+    arr->reserved_size = count;
+}
+
+template<typename T>
+static void _reserve_exact(set<T> *st, u64 count, spirv_info *info)
+{
+    // heap sets grow on their own
+    if (!info->use_arena)
+        return;
+
+    _count_allocation(count * sizeof(T));
+
+    assert(st->data == nullptr);
+    st->data = allocate<T>(&info->arena, count);
+    st->reserved_size = count;
 }
 
-void free(spirv_id_instruction *instr)
+static inline bool _is_type_opcode(u16 opcode)
 {
-    ::free(&instr->decoration_indices);
+    return get_spirv_opcode_info(opcode)->flags & spirv_opcode_flag_type;
+}
+
+static inline bool _is_variable_opcode(u16 opcode)
+{
+    return get_spirv_opcode_info(opcode)->flags & spirv_opcode_flag_value;
+}
+
+// the checks every instruction gets: long enough for its opcode and
+// the result id, if any, within the bound.
+static inline void _check_instruction(const spirv_instruction *instr, const spirv_opcode_info *op, u32 bound)
+{
+    assert(instr->word_count >= op->min_word_count);
+    assert(op->result_id_word == 0 || instr->words[op->result_id_word] < bound);
+    (void)instr; (void)op; (void)bound;
+}
+
+// upper bounds of everything the parser stores, gathered by walking
+// the instruction headers once before parsing so that every container
+// can be allocated exactly once.
+struct spirv_module_counts
+{
+    u64 entry_points;
+    u64 execution_modes;
+    u64 types;
+    u64 struct_members;
+    u64 variables; // includes function-local variables
+    u64 decorations;
+    u64 member_names;
+    u64 member_decorations;
+    u64 functions;
+    u64 instructions;
+};
+
+// decorations whose literal operand the parser reads, as a bit per
+// decoration. all of them are below 64.
+#define _bit(X) (1ull << (X))
+static constexpr u64 _decorations_with_literal
+    = _bit(SpvDecorationSpecId) | _bit(SpvDecorationArrayStride) | _bit(SpvDecorationMatrixStride)
+    | _bit(SpvDecorationBuiltIn) | _bit(SpvDecorationLocation) | _bit(SpvDecorationComponent)
+    | _bit(SpvDecorationIndex) | _bit(SpvDecorationBinding) | _bit(SpvDecorationDescriptorSet)
+    | _bit(SpvDecorationOffset) | _bit(SpvDecorationInputAttachmentIndex) | _bit(SpvDecorationAlignment);
+#undef _bit
+
+static inline u32 _decoration_literal_count(u32 decoration)
+{
+    return decoration < 64 ? (u32)((_decorations_with_literal >> decoration) & 1) : 0;
+}
+
+// true if one of the 4 bytes of v is 0, i.e. v ends a string
+static inline bool _has_zero_byte(u32 v)
+{
+    return ((v - 0x01010101u) & ~v & 0x80808080u) != 0;
+}
+
+// the checks of the validating parse, done on every instruction in the
+// counting walk so that the parse itself can rely on them:
+// the word count covers the fixed operands, every id operand is within
+// the bound and string operands end inside the instruction.
+// checks are accumulated instead of branched on. end is the end of the
+// stream, the instruction itself is known to be inside it.
+static bool _validate_instruction(const spirv_instruction *instr, const spirv_opcode_info *op, u32 bound, const u32 *end)
+{
+    u32 word_count = instr->word_count;
+
+    if (word_count < op->min_word_count)
+        return false;
+
+    const u32 *words = instr->words;
+    bool bad = false;
+
+    // fixed ids are at words 1 to 4, all of them are compared and the
+    // ones that are not ids are masked out. only the last instructions
+    // of the stream are copied to not read past it.
+    const u32 *fixed = words;
+    u32 tail[5] = {};
+
+    if (words + 5 > end)
+    {
+        ::copy_memory(words, tail, sizeof(u32) * (word_count < 5 ? word_count : 5));
+        fixed = tail;
+    }
+
+    u32 out_of_bounds = ((u32)(fixed[1] >= bound) << 1)
+                      | ((u32)(fixed[2] >= bound) << 2)
+                      | ((u32)(fixed[3] >= bound) << 3)
+                      | ((u32)(fixed[4] >= bound) << 4);
+
+    bad |= (out_of_bounds & op->id_words) != 0;
+
+    // a string ends in the first word with a zero byte. if the last
+    // word of the instruction has one, the string ends inside it.
+    if (op->string_word != 0)
+        bad |= !_has_zero_byte(words[word_count - 1]);
+
+    u32 trailing = op->trailing_word;
+
+    // ids after the string, only OpEntryPoint
+    if (trailing == SPIRV_AFTER_STRING)
+    {
+        trailing = op->string_word;
+
+        while (trailing < word_count && !_has_zero_byte(words[trailing]))
+            ++trailing;
+
+        ++trailing;
+    }
+
+    if (trailing != 0)
+    for (u32 w = trailing; w < word_count; ++w)
+        bad |= words[w] >= bound;
+
+    // min_word_count covers the decoration itself, words[2] of OpDecorate
+    // and words[3] of OpMemberDecorate
+    if (instr->opcode == SpvOpDecorate)
+        bad |= word_count < 3 + _decoration_literal_count(words[2]);
+    else if (instr->opcode == SpvOpMemberDecorate)
+        bad |= word_count < 4 + _decoration_literal_count(words[3]);
+
+    return !bad;
+}
+
+// with Validate, every instruction header is checked against the stream
+// before it is skipped and every instruction is checked with
+// _validate_instruction. returns false and sets err on the first
+// invalid instruction.
+template<bool Validate>
+static bool _count_module(memory_stream stream, spirv_module_counts *counts, u32 bound, error *err)
+{
+    u64 index = 0;
+
+    while (stream.position + sizeof(u32) <= stream.size)
+    {
+        spirv_instruction _instr{};
+        spirv_instruction *instr = &_instr;
+
+        instr->words = (u32*)::current(&stream);
+        read(&stream, &instr->opcode);
+        read(&stream, &instr->word_count);
+
+        if constexpr (Validate)
+        {
+            u64 remaining_words = (stream.size - stream.position) / sizeof(u32);
+
+            if (instr->word_count == 0 || instr->word_count - 1u > remaining_words)
+            {
+                get_spirv_parse_error(err, INSTR_FMT " invalid word count %u", index, (u32)instr->word_count);
+                return false;
+            }
+
+            if (!_validate_instruction(instr, get_spirv_opcode_info(instr->opcode), bound, (u32*)(stream.data + stream.size)))
+            {
+                get_spirv_parse_error(err, INSTR_FMT " invalid operands of opcode %u", index, (u32)instr->opcode);
+                return false;
+            }
+        }
+        else
+            assert(instr->word_count >= 1);
+
+        stream.position += sizeof(u32) * (instr->word_count - 1);
+        index++;
+        counts->instructions++;
+
+        switch (instr->opcode)
+        {
+        case SpvOpEntryPoint:       counts->entry_points++; continue;
+        case SpvOpExecutionMode:
+        case SpvOpExecutionModeId:  counts->execution_modes++; continue;
+        case SpvOpMemberName:       counts->member_names++; continue;
+        case SpvOpFunction:         counts->functions++; continue;
+        case SpvOpMemberDecorate:
+            counts->member_decorations++;
+            [[fallthrough]];
+        case SpvOpDecorate:
+        case SpvOpDecorateId:
+            counts->decorations++;
+            continue;
+        case SpvOpTypeStruct:
+            if (instr->word_count >= 2)
+                counts->struct_members += instr->word_count - 2;
+            break;
+        default:
+            break;
+        }
+
+        if (_is_type_opcode(instr->opcode))
+            counts->types++;
+        else if (_is_variable_opcode(instr->opcode))
+            counts->variables++;
+    }
+
+    return true;
+}
+
+// validating parse: operands that must be types are ids of types declared
+// before, which is what compute_type_layouts relies on. pointers may
+// point to types declared after them (OpTypeForwardPointer), but not to
+// later pointers, which could form cycles.
+// done once all types are known. index is the index of the type in
+// spirv_info::types, max_value(u32) for constants and variables.
+static bool _validate_type_operands(const spirv_instruction *instr, u32 index, const spirv_info *info)
+{
+    const spirv_opcode_info *op = get_spirv_opcode_info(instr->opcode);
+    const u16 *opcodes = info->ids.opcodes.data;
+    const u32 *extras = info->ids.extras.data;
+    const u32 *words = instr->words;
+    bool bad = false;
+
+    for (u32 mask = op->type_words; mask != 0; mask &= mask - 1)
+    {
+        SpvId id = (SpvId)words[__builtin_ctz(mask)];
+        bool declared_before = extras[id] < index;
+
+        bad |= !_is_type_opcode(opcodes[id]);
+
+        if (instr->opcode == SpvOpTypePointer)
+            bad |= !declared_before && opcodes[id] == SpvOpTypePointer;
+        else
+            bad |= !declared_before;
+    }
+
+    if (op->flags & spirv_opcode_flag_trailing_types)
+    for (u32 w = op->trailing_word; w < instr->word_count; ++w)
+        bad |= !_is_type_opcode(opcodes[words[w]]) || extras[words[w]] >= index;
+
+    switch (instr->opcode)
+    {
+    case SpvOpTypeInt:
+    case SpvOpTypeFloat:
+        // width in bits, 8 to 64 and a power of two
+        bad |= words[2] < 8 || words[2] > 64 || (words[2] & (words[2] - 1)) != 0;
+        break;
+    case SpvOpTypeVector:
+        bad |= opcodes[words[2]] != SpvOpTypeInt && opcodes[words[2]] != SpvOpTypeFloat && opcodes[words[2]] != SpvOpTypeBool;
+        break;
+    case SpvOpTypeMatrix:
+        bad |= opcodes[words[2]] != SpvOpTypeVector;
+        break;
+    default:
+        break;
+    }
+
+    return !bad;
+}
+
+// approximate number of bytes the parse will take from the arena
+static u64 _estimate_arena_size(const spirv_module_counts *counts, u32 bound)
+{
+    u64 size = 0;
+    size += bound * spirv_id_table_bytes_per_id;
+    size += (bound + 1) * sizeof(u32);
+    size += counts->decorations * (sizeof(spirv_instruction) + sizeof(u32));
+    size += counts->entry_points * sizeof(spirv_entry_point);
+    size += counts->execution_modes * sizeof(spirv_entry_point_execution_mode);
+    size += counts->types * sizeof(spirv_type);
+    size += counts->struct_members * sizeof(spirv_struct_type_member);
+    size += counts->variables * sizeof(spirv_variable);
+    size += counts->functions * sizeof(spirv_function);
+    size += (counts->member_names + counts->member_decorations) * sizeof(spirv_instruction);
+
+    // alignment padding of the referenced variables
+    size += counts->functions * 64 + 4096;
+
+    return size;
+}
+
+// builds the per-id decoration index in compressed sparse row form from
+// info->decorations: one counting pass, one prefix sum, one fill pass.
+static void _build_decoration_index(spirv_info *info, u32 bound)
+{
+    _reserve_exact(&info->decoration_offsets, bound + 1, info);
+    info->decoration_offsets.size = bound + 1;
+
+    u32 *offsets = info->decoration_offsets.data;
+    ::fill_memory(offsets, 0, bound + 1);
+
+    // count, offsets[id + 1] is the number of decorations of id
+    u32 total = 0;
+
+    for_array(decor, &info->decorations)
+    {
+        SpvId target_id = (SpvId)decor->words[1];
+
+        if (target_id >= bound)
+            continue;
+
+        offsets[target_id + 1]++;
+        total++;
+    }
+
+    // offsets[id + 1] becomes the start of id
+    u32 start = 0;
+
+    for (u32 id = 0; id < bound; ++id)
+    {
+        u32 count = offsets[id + 1];
+        offsets[id + 1] = start;
+        start += count;
+    }
+
+    _reserve_exact(&info->decoration_indices, total, info);
+    info->decoration_indices.size = total;
+
+    // fill, afterwards offsets[id + 1] is the end of id, which is the start of id + 1
+    for_array(i, decor, &info->decorations)
+    {
+        SpvId target_id = (SpvId)decor->words[1];
+
+        if (target_id >= bound)
+            continue;
+
+        info->decoration_indices[offsets[target_id + 1]++] = (u32)i;
+    }
+}
+
+u32 *get_decoration_indices(spirv_info *info, SpvId id, u32 *count)
+{
+    assert(count != nullptr);
+
+    if (id + 1 >= info->decoration_offsets.size)
+    {
+        *count = 0;
+        return nullptr;
+    }
+
+    u32 start = info->decoration_offsets[id];
+    *count = info->decoration_offsets[id + 1] - start;
+
+    return info->decoration_indices.data + start;
+}
+
+spirv_instruction get_id_instruction(const spirv_info *info, SpvId id)
+{
+    spirv_instruction ret{};
+
+    if (id >= info->ids.opcodes.size || info->ids.opcodes[id] == SpvOpNop)
+        return ret;
+
+    ret.words = ((u32*)info->data.data) + info->ids.word_offsets[id];
+    ret.word_count = info->ids.word_counts[id];
+    ret.opcode = info->ids.opcodes[id];
+    ret.extra = info->ids.extras[id];
+
+    return ret;
+}
+
+const char *get_id_name(const spirv_info *info, SpvId id)
+{
+    if (id >= info->ids.names.size)
+        return nullptr;
+
+    return info->ids.names[id];
+}
+
+static void _set_id_instruction(spirv_info *info, SpvId id, const spirv_instruction *instr)
+{
+    info->ids.opcodes[id] = instr->opcode;
+    info->ids.word_counts[id] = instr->word_count;
+    info->ids.word_offsets[id] = (u32)(instr->words - (u32*)info->data.data);
+}
+
+// _set_id_instruction for result ids. the validating parse rejects ids
+// that are defined twice, a later definition would replace what the
+// earlier checks looked at, e.g. an OpFunction the id of a type.
+static bool _define_id(spirv_info *info, SpvId id, const spirv_instruction *instr, bool validate, u64 index, error *err)
+{
+    if (validate && info->ids.opcodes[id] != SpvOpNop)
+    {
+        get_spirv_parse_error(err, INSTR_FMT " result id %%%u is already defined", index, id);
+        return false;
+    }
+
+    _set_id_instruction(info, id, instr);
+    return true;
+}
+
+static void _init_id_table(spirv_info *info, u32 bound)
+{
+    spirv_id_table *ids = &info->ids;
+
+    _reserve_exact(&ids->opcodes, bound, info);
+    _reserve_exact(&ids->word_counts, bound, info);
+    _reserve_exact(&ids->word_offsets, bound, info);
+    _reserve_exact(&ids->extras, bound, info);
+    _reserve_exact(&ids->names, bound, info);
+
+    ids->opcodes.size = bound;
+    ids->word_counts.size = bound;
+    ids->word_offsets.size = bound;
+    ids->extras.size = bound;
+    ids->names.size = bound;
+
+    ::fill_memory(ids->opcodes.data, 0, bound);
+    ::fill_memory(ids->word_counts.data, 0, bound);
+    ::fill_memory(ids->word_offsets.data, 0, bound);
+    ::fill_memory(ids->extras.data, 0xff, bound); // max_value(u32), no extra
+    ::fill_memory(ids->names.data, 0, bound);
+}
+
+static void _free_id_table(spirv_id_table *ids)
+{
+    ::free(&ids->opcodes);
+    ::free(&ids->word_counts);
+    ::free(&ids->word_offsets);
+    ::free(&ids->extras);
+    ::free(&ids->names);
 }
 
 void init(spirv_function *func)
@@ -87,25 +705,111 @@ void init(spirv_info *info)
     ::fill_memory(info, 0);
 }
 
+static void _free_input(spirv_info *info)
+{
+    // the input of parse_spirv_from_memory is borrowed, a converted
+    // copy in the arena is released with the arena.
+    if (info->owned_data.data != nullptr)
+        ::close(&info->owned_data);
+
+    if (info->mapping.data != nullptr)
+        ::unmap_file(&info->mapping);
+
+    info->data = memory_stream{};
+}
+
 void free(spirv_info *info)
 {
     if (info == nullptr)
         return;
 
-    ::free<true>(&info->id_instructions);
+    if (info->use_arena)
+    {
+        // everything except the input lives in the arena
+        ::free(&info->arena);
+        _free_input(info);
+        return;
+    }
+
+    _free_id_table(&info->ids);
     ::free<true>(&info->entry_points);
     ::free<true>(&info->types);
     ::free<true>(&info->functions);
     ::free(&info->variables);
     ::free(&info->decorations);
+    ::free(&info->decoration_offsets);
+    ::free(&info->decoration_indices);
+
+    _free_input(info);
+}
+
+template<typename C>
+static inline u64 _reserved_bytes(const C *c)
+{
+    return c->reserved_size * sizeof(*c->data);
+}
+
+void get_memory_usage(const spirv_info *info, spirv_info_memory_usage *out)
+{
+    assert(info != nullptr);
+    assert(out != nullptr);
+
+    ::fill_memory(out, 0);
+
+    const spirv_id_table *ids = &info->ids;
+    out->id_table = _reserved_bytes(&ids->opcodes) + _reserved_bytes(&ids->word_counts)
+                  + _reserved_bytes(&ids->word_offsets) + _reserved_bytes(&ids->extras)
+                  + _reserved_bytes(&ids->names);
+
+    out->decorations = _reserved_bytes(&info->decorations)
+                     + _reserved_bytes(&info->decoration_offsets)
+                     + _reserved_bytes(&info->decoration_indices);
+
+    out->entry_points = _reserved_bytes(&info->entry_points);
 
-    ::close(&info->data);
+    for_array(ep, &info->entry_points)
+        out->entry_points += _reserved_bytes(&ep->execution_modes);
+
+    out->types = _reserved_bytes(&info->types);
+
+    for_array(t, &info->types)
+        out->types += _reserved_bytes(&t->members);
+
+    out->variables = _reserved_bytes(&info->variables);
+
+    out->functions = _reserved_bytes(&info->functions);
+
+    for_array(func, &info->functions)
+        out->functions += _reserved_bytes(&func->called_function_indices)
+                        + _reserved_bytes(&func->referenced_variables);
+
+    if (info->mapping.data != nullptr)
+        out->mapped = info->mapping.size;
+    else if (info->data_in_arena)
+        out->data = info->data.size;
+    else
+        out->data = info->owned_data.size;
+
+    u64 containers = out->id_table + out->decorations + out->entry_points
+                   + out->types + out->variables + out->functions;
+
+    if (info->use_arena)
+    {
+        u64 arena_bytes = ::get_block_bytes(&info->arena);
+        u64 in_arena = containers + (info->data_in_arena ? out->data : 0);
+
+        if (arena_bytes > in_arena)
+            out->arena_overhead = arena_bytes - in_arena;
+    }
+
+    out->total = containers + out->data + out->arena_overhead;
+    out->parse_peak = info->parse_peak_bytes;
 }
 
 spirv_entry_point *get_entry_point_by_id(spirv_info *info, SpvId id)
 {
     for_array(ep, &info->entry_points)
-        if (ep->instruction->id == id)
+        if (ep->id == id)
             return ep;
 
     return nullptr;
@@ -113,34 +817,54 @@ spirv_entry_point *get_entry_point_by_id(spirv_info *info, SpvId id)
 
 spirv_type *_get_type_by_id(spirv_info *info, SpvId id)
 {
-    return info->types.data + info->id_instructions[id].extra;
+    return info->types.data + info->ids.extras[id];
 }
 
-spirv_variable *_get_variable_by_id(spirv_info *info, SpvId id)
+spirv_type *get_type_by_id(spirv_info *info, SpvId id)
 {
-    return info->variables.data + info->id_instructions[id].extra;
+    if (id >= info->ids.opcodes.size || !_is_type_opcode(info->ids.opcodes[id]))
+        return nullptr;
+
+    return _get_type_by_id(info, id);
 }
 
-void _add_referenced_variable_by_id(SpvId id, spirv_function *func, spirv_info *info)
+spirv_variable *_get_variable_by_id(spirv_info *info, SpvId id)
 {
-    u32 index = info->id_instructions[id].extra;
+    return info->variables.data + info->ids.extras[id];
+}
 
-    if (index == max_value(u32))
+static void _add_referenced_variable_by_id(SpvId id, set<spirv_variable*> *variables, spirv_info *info)
+{
+    if (id >= info->ids.opcodes.size || !_is_variable_opcode(info->ids.opcodes[id]))
         return;
 
+    u32 index = info->ids.extras[id];
+
     if (index >= info->variables.size)
         return;
 
-    ::insert_element(&func->referenced_variables, info->variables.data + index);
+    ::insert_element(variables, info->variables.data + index);
 }
 
-void collect_function_used_variables(spirv_function *func, spirv_info *info)
+// walks the body of one function, collecting the variables it references
+// directly and the indices of the functions it calls.
+// last_caller[f] is the index of the last function that recorded a call
+// to f, so repeated calls are skipped without searching calls.
+static void _collect_function_body(u32 func_index, spirv_info *info, set<spirv_variable*> *variables, array<u32> *calls, array<u32> *last_caller)
 {
-    spirv_instruction instr;
-    ::copy_memory(func->instruction, &instr, sizeof(spirv_instruction));
+    spirv_function *func = info->functions.data + func_index;
+    spirv_parse_phase_stats *stats = _phase_stats;
+
+    spirv_instruction instr = func->instruction;
 
     while (next_instruction(&info->data, &instr))
     {
+        if (stats != nullptr)
+        {
+            stats->instructions++;
+            stats->bytes += instr.word_count * sizeof(u32);
+        }
+
         if (instr.opcode == SpvOpFunctionEnd)
             break;
 
@@ -150,30 +874,327 @@ void collect_function_used_variables(spirv_function *func, spirv_info *info)
         {
             // we only really care about base_id, the rest is fields inside it
             SpvId base_id = (SpvId)instr.words[3];
-            _add_referenced_variable_by_id(base_id, func, info);
+            _add_referenced_variable_by_id(base_id, variables, info);
             break;
         }
         case SpvOpLoad:
         {
             SpvId base_id = (SpvId)instr.words[3];
-            _add_referenced_variable_by_id(base_id, func, info);
+            _add_referenced_variable_by_id(base_id, variables, info);
             break;
         }
+        case SpvOpFunctionCall:
+        {
+            SpvId callee_id = (SpvId)instr.words[3];
+
+            // variables passed as pointer arguments are used by the callee
+            // through its parameters, which is only visible here
+            for (u32 arg = 4; arg < instr.word_count; ++arg)
+                _add_referenced_variable_by_id((SpvId)instr.words[arg], variables, info);
+
+            if (callee_id >= info->ids.opcodes.size || info->ids.opcodes[callee_id] != SpvOpFunction)
+                break;
+
+            u32 callee = info->ids.extras[callee_id];
+
+            if (last_caller->data[callee] != func_index)
+            {
+                last_caller->data[callee] = func_index;
+                ::add_at_end(calls, callee);
+            }
+
+            break;
+        }
+
+        }
+    }
+}
+
+static void _add_all(set<spirv_variable*> *dst, const set<spirv_variable*> *src)
+{
+    for_array(var, src)
+        ::insert_element(dst, *var);
+}
+
+// moves a scratch container into a function. with an arena the contents
+// are copied to the arena instead, heap containers are taken over.
+template<typename C>
+static void _store_scratch(C *dst, C *scratch, spirv_info *info)
+{
+    if (!info->use_arena)
+    {
+        _count_allocation(scratch->reserved_size * sizeof(*scratch->data));
+        *dst = *scratch;
+        ::init(scratch);
+        return;
+    }
+
+    _reserve_exact(dst, scratch->size, info);
+
+    if (scratch->size > 0)
+        ::copy_memory(scratch->data, dst->data, scratch->size * sizeof(*scratch->data));
+
+    dst->size = scratch->size;
+}
+
+#define SPIRV_VERSION_1_4 0x00010400
+
+// since SPIR-V 1.4 the interface of an entry point lists every global
+// variable its static call tree uses, so no function body is walked.
+// call edges are not recorded on this path, called_function_indices
+// stays empty and functions other than entry points reference nothing.
+// returns the bytes of scratch memory still held at the end.
+static u64 _collect_entry_point_interfaces(spirv_info *info, const spirv_trace_sink *trace)
+{
+    set<spirv_variable*> scratch{};
+    ::init(&scratch);
+    defer { ::free(&scratch); };
+
+    for_array(ep, &info->entry_points)
+    {
+        spirv_function *func = info->functions.data + ep->function_index;
+
+        // entry points sharing a function have the same interface
+        if (func->referenced_variables.data != nullptr)
+            continue;
+
+        scratch.size = 0;
+
+        for (u16 r = 0; r < ep->ref_count; ++r)
+            _add_referenced_variable_by_id(ep->refs[r], &scratch, info);
+
+        _store_scratch(&func->referenced_variables, &scratch, info);
+
+        if (spirv_trace_enabled(trace, spirv_trace_level_verbose))
+        for_array(var, &func->referenced_variables)
+            _trace(trace, "entry point %s (%%%u) references variable %%%u\n", ep->name, func->id, (*var)->id);
+    }
+
+    return _reserved_bytes(&scratch);
+}
+
+struct _scc_frame
+{
+    u32 function_index;
+    u32 next_call; // index into the functions calls
+};
+
+#define UNVISITED max_value(u32)
+
+// returns the bytes of scratch memory still held at the end, which is
+// when collecting holds the most.
+static u64 _collect_function_information(spirv_info *info, const spirv_trace_sink *trace)
+{
+    // we want to know all variables referenced in entry points, including
+    // the ones only used by called functions, so that we can generate
+    // DescriptorSet layouts.
+    // only functions reachable from an entry point are looked at.
+    if (info->version >= SPIRV_VERSION_1_4)
+        return _collect_entry_point_interfaces(info, trace);
+
+    u64 func_count = info->functions.size;
+
+    array<set<spirv_variable*>> variables{};
+    array<array<u32>> calls{};
+    array<u32> reached{};
+    array<bool> is_reached{};
+    array<u32> index_of{};
+    array<u32> lowlink{};
+    array<u32> scc_of{};
+    array<u32> scc_stack{};
+    array<_scc_frame> frames{};
+    array<u32> last_caller{};
+
+    defer
+    {
+        ::free<true>(&variables);
+        ::free<true>(&calls);
+        ::free(&reached);
+        ::free(&is_reached);
+        ::free(&index_of);
+        ::free(&lowlink);
+        ::free(&scc_of);
+        ::free(&scc_stack);
+        ::free(&frames);
+        ::free(&last_caller);
+    };
+
+    ::resize(&variables, func_count);
+    ::resize(&last_caller, func_count);
+    ::resize(&calls, func_count);
+    ::resize(&is_reached, func_count);
+    ::resize(&index_of, func_count);
+    ::resize(&lowlink, func_count);
+    ::resize(&scc_of, func_count);
+
+    for (u64 i = 0; i < func_count; ++i)
+    {
+        ::init(variables.data + i);
+        ::init(calls.data + i);
+        is_reached[i] = false;
+        index_of[i] = UNVISITED;
+        scc_of[i] = UNVISITED;
+        last_caller[i] = UNVISITED;
+    }
+
+    // 1. walk the bodies of reachable functions once, recording direct
+    //    variable references and call edges.
+    for_array(ep, &info->entry_points)
+    if (!is_reached[ep->function_index])
+    {
+        is_reached[ep->function_index] = true;
+        ::add_at_end(&reached, ep->function_index);
+    }
+
+    for (u64 r = 0; r < reached.size; ++r)
+    {
+        u32 f = reached[r];
+        _collect_function_body(f, info, variables.data + f, calls.data + f, &last_caller);
+
+        for_array(callee, calls.data + f)
+        if (!is_reached[*callee])
+        {
+            is_reached[*callee] = true;
+            ::add_at_end(&reached, *callee);
+        }
+    }
+
+    if (spirv_trace_enabled(trace, spirv_trace_level_verbose))
+    for_array(func, &info->functions)
+    if (!is_reached[func - info->functions.data])
+        _trace(trace, "function %s (%%%u) is not reachable from any entry point\n", get_id_name(info, func->id), func->id);
+
+    // 2. Tarjans SCC algorithm, iteratively. SCCs complete callees first,
+    //    so when an SCC completes every function it calls outside of it
+    //    already holds its transitive set. recursive functions are not
+    //    allowed in shaders, but kernels may have them.
+    u32 next_index = 0;
+    u32 scc_count = 0;
+
+    for_array(root, &reached)
+    {
+        if (index_of[*root] != UNVISITED)
+            continue;
+
+        index_of[*root] = lowlink[*root] = next_index++;
+        ::add_at_end(&scc_stack, *root);
+        ::add_at_end(&frames, _scc_frame{*root, 0});
+
+        while (frames.size > 0)
+        {
+            _scc_frame *frame = frames.data + frames.size - 1;
+            u32 v = frame->function_index;
+            array<u32> *v_calls = calls.data + v;
+
+            if (frame->next_call < v_calls->size)
+            {
+                u32 w = v_calls->data[frame->next_call++];
+
+                if (index_of[w] == UNVISITED)
+                {
+                    index_of[w] = lowlink[w] = next_index++;
+                    ::add_at_end(&scc_stack, w);
+                    ::add_at_end(&frames, _scc_frame{w, 0});
+                }
+                else if (scc_of[w] == UNVISITED && index_of[w] < lowlink[v])
+                    // w is still on the stack
+                    lowlink[v] = index_of[w];
+
+                continue;
+            }
+
+            frames.size--;
+
+            if (frames.size > 0)
+            {
+                u32 parent = frames[frames.size - 1].function_index;
+
+                if (lowlink[v] < lowlink[parent])
+                    lowlink[parent] = lowlink[v];
+            }
+
+            if (lowlink[v] != index_of[v])
+                continue;
+
+            // v is the root of an SCC, its members are on top of the stack
+            u64 first = scc_stack.size;
+
+            do
+                first--;
+            while (scc_stack[first] != v);
+
+            u32 scc = scc_count++;
+
+            for (u64 m = first; m < scc_stack.size; ++m)
+                scc_of[scc_stack[m]] = scc;
+
+            set<spirv_variable*> *combined = variables.data + v;
+
+            for (u64 m = first; m < scc_stack.size; ++m)
+            {
+                u32 member = scc_stack[m];
+
+                if (member != v)
+                    _add_all(combined, variables.data + member);
+
+                for_array(callee, calls.data + member)
+                if (scc_of[*callee] != scc)
+                    _add_all(combined, variables.data + *callee);
+            }
+
+            for (u64 m = first; m < scc_stack.size; ++m)
+            {
+                u32 member = scc_stack[m];
+
+                if (member == v)
+                    continue;
+
+                variables[member].size = 0;
+                _add_all(variables.data + member, combined);
+            }
 
+            scc_stack.size = first;
         }
     }
 
-    for_array(var, &func->referenced_variables)
-        printf("function %s (%%%u) references variable %%%u\n", func->instruction->name, func->instruction->id, (*var)->instruction->id);
+    // 3. move the results into the functions
+    for_array(f, &reached)
+    {
+        spirv_function *func = info->functions.data + *f;
+
+        _store_scratch(&func->called_function_indices, calls.data + *f, info);
+        _store_scratch(&func->referenced_variables, variables.data + *f, info);
+
+        if (!spirv_trace_enabled(trace, spirv_trace_level_verbose))
+            continue;
+
+        for_array(callee, &func->called_function_indices)
+            _trace(trace, "function %s (%%%u) calls %%%u\n", get_id_name(info, func->id), func->id, info->functions[*callee].id);
+
+        for_array(var, &func->referenced_variables)
+            _trace(trace, "function %s (%%%u) references variable %%%u\n", get_id_name(info, func->id), func->id, (*var)->id);
+    }
+
+    // heap results were taken over by the functions and are empty here
+    u64 scratch_bytes = _reserved_bytes(&variables) + _reserved_bytes(&calls)
+                      + _reserved_bytes(&reached) + _reserved_bytes(&is_reached)
+                      + _reserved_bytes(&index_of)
+                      + _reserved_bytes(&lowlink) + _reserved_bytes(&scc_of)
+                      + _reserved_bytes(&scc_stack) + _reserved_bytes(&frames)
+                      + _reserved_bytes(&last_caller);
+
+    for (u64 i = 0; i < func_count; ++i)
+        scratch_bytes += _reserved_bytes(variables.data + i) + _reserved_bytes(calls.data + i);
+
+    return scratch_bytes;
 }
 
-void collect_function_information(spirv_info *info)
+void collect_function_information(spirv_info *info, const spirv_trace_sink *trace)
 {
-    // we want to know all variables referenced in entry points
-    // so that we can generate DescriptorSet layouts
-    
-    for_array(func, &info->functions)
-        collect_function_used_variables(func, info);
+    if (trace == nullptr)
+        trace = &_null_trace_sink;
+
+    _collect_function_information(info, trace);
 }
 
 const char *storage_class_name(SpvStorageClass storage)
@@ -199,125 +1220,246 @@ const char *storage_class_name(SpvStorageClass storage)
     return "";
 }
 
-u64 calculate_type_size(spirv_type *t, spirv_info *info)
+#define align_up(X, A) ((((X) + (A) - 1) / (A)) * (A))
+
+// SPIR-V 1.5, not in spirv1_2.h
+#define SPIRV_STORAGE_CLASS_PHYSICAL_STORAGE_BUFFER 5349
+
+static u32 _get_array_length(spirv_type *t, spirv_info *info)
+{
+    SpvId length_id = (SpvId)t->instruction.words[3];
+
+    if (length_id >= info->ids.opcodes.size)
+        return 0;
+
+    // spec constants have their default value, OpSpecConstantOp is not
+    // evaluated.
+    u16 opcode = info->ids.opcodes[length_id];
+
+    if (opcode != SpvOpConstant && opcode != SpvOpSpecConstant)
+        return 0;
+
+    spirv_variable *length_var = _get_variable_by_id(info, length_id);
+
+    // maybe handle larger types
+    if (length_var->instruction.word_count < 4)
+        return 0;
+
+    return length_var->instruction.words[3];
+}
+
+static u32 _get_array_stride_decoration(spirv_type *t, spirv_info *info)
+{
+    u32 count = 0;
+    u32 *indices = get_decoration_indices(info, t->id, &count);
+
+    for (u32 d = 0; d < count; ++d)
+    {
+        spirv_instruction *decor = info->decorations.data + indices[d];
+
+        if (decor->opcode == SpvOpDecorate
+         && (SpvDecoration)decor->words[2] == SpvDecorationArrayStride)
+            return decor->words[3];
+    }
+
+    return 0;
+}
+
+// column (or row) stride of a matrix whose vectors have the given layout
+static u32 _matrix_stride(u64 vector_size, u32 vector_alignment, spirv_layout_rules rules)
+{
+    switch (rules)
+    {
+    case spirv_layout_rules_std140: return (u32)align_up(vector_size, 16);
+    case spirv_layout_rules_std430: return (u32)align_up(vector_size, vector_alignment);
+    case spirv_layout_rules_scalar: return (u32)vector_size;
+    }
+
+    return (u32)vector_size;
+}
+
+// size and alignment of a struct member, matrix members may have their
+// own stride / major-ness. row major matrices are laid out like an array
+// of their row vectors.
+static void _member_layout(spirv_struct_type_member *mem, spirv_type *mem_type, spirv_info *info, spirv_layout_rules rules)
 {
-    if (t->size != UNCALCULATED)
-        return t->size;
+    mem->size = mem_type->size;
+    mem->alignment = mem_type->alignment;
 
-    switch (t->instruction->opcode)
+    if (mem_type->instruction.opcode != SpvOpTypeMatrix
+     || (mem->matrix_stride == 0 && !mem->row_major))
+        return;
+
+    spirv_type *column_type = _get_type_by_id(info, (SpvId)mem_type->instruction.words[2]);
+    u32 column_count = mem_type->instruction.words[3];
+    u32 row_count = column_type->instruction.words[3];
+
+    u32 vector_count = column_count;
+    u32 stride = mem->matrix_stride;
+
+    if (mem->row_major)
+    {
+        // row vectors have column_count components of the column scalar type
+        spirv_type *scalar_type = _get_type_by_id(info, (SpvId)column_type->instruction.words[2]);
+        u64 row_size = scalar_type->size * column_count;
+        u32 row_alignment = rules == spirv_layout_rules_scalar ? scalar_type->alignment : scalar_type->alignment * (column_count == 2 ? 2 : 4);
+
+        vector_count = row_count;
+        mem->alignment = row_alignment;
+
+        if (rules == spirv_layout_rules_std140 && mem->alignment < 16)
+            mem->alignment = 16;
+
+        if (stride == 0)
+            stride = _matrix_stride(row_size, row_alignment, rules);
+    }
+
+    mem->size = (u64)stride * vector_count;
+}
+
+static void _compute_type_layout(spirv_type *t, spirv_info *info, spirv_layout_rules rules)
+{
+    const spirv_instruction *instr = &t->instruction;
+
+    t->size = 0;
+    t->alignment = 1;
+    t->stride = 0;
+
+    switch (instr->opcode)
     {
-    case SpvOpTypeVoid:   return 0;
-    case SpvOpTypeBool:   return 0;
-    case SpvOpTypeInt:    return t->instruction->words[2] / 8;
-    case SpvOpTypeFloat:  return t->instruction->words[2] / 8;
+    case SpvOpTypeInt:
+    case SpvOpTypeFloat:
+    {
+        t->size = instr->words[2] / 8;
+        t->alignment = (u32)t->size;
+        break;
+    }
     case SpvOpTypeVector:
     {
-        SpvId comp_id = (SpvId)t->instruction->words[2];
-        spirv_type *comp_type = _get_type_by_id(info, comp_id);
-        u32 comp_count = t->instruction->words[3];
-        return calculate_type_size(comp_type, info) * comp_count;
+        spirv_type *comp_type = _get_type_by_id(info, (SpvId)instr->words[2]);
+        u32 comp_count = instr->words[3];
+
+        t->size = comp_type->size * comp_count;
+
+        // 2 component vectors are aligned to twice, 3 and 4 component
+        // vectors to four times their component.
+        if (rules == spirv_layout_rules_scalar)
+            t->alignment = comp_type->alignment;
+        else
+            t->alignment = comp_type->alignment * (comp_count == 2 ? 2 : 4);
+
+        break;
     }
     case SpvOpTypeMatrix:
     {
-        SpvId comp_id = (SpvId)t->instruction->words[2];
-        spirv_type *comp_type = _get_type_by_id(info, comp_id);
-        u32 comp_count = t->instruction->words[3];
-        return calculate_type_size(comp_type, info) * comp_count;
+        // a matrix is laid out like an array of its column vectors
+        spirv_type *column_type = _get_type_by_id(info, (SpvId)instr->words[2]);
+        u32 column_count = instr->words[3];
+
+        t->stride = _matrix_stride(column_type->size, column_type->alignment, rules);
+        t->size = (u64)t->stride * column_count;
+        t->alignment = column_type->alignment;
+
+        if (rules == spirv_layout_rules_std140 && t->alignment < 16)
+            t->alignment = 16;
+
+        break;
     }
-    case SpvOpTypeImage:        return 0;
-    case SpvOpTypeSampler:      return 0;
-    case SpvOpTypeSampledImage: return 0;
     case SpvOpTypeArray:
+    case SpvOpTypeRuntimeArray:
     {
-        SpvId elem_type_id = (SpvId)t->instruction->words[2];
-        spirv_type *elem_type = _get_type_by_id(info, elem_type_id);
+        spirv_type *elem_type = _get_type_by_id(info, (SpvId)instr->words[2]);
 
-        SpvId length_var_id = (SpvId)t->instruction->words[3];
-        spirv_variable *length_var = _get_variable_by_id(info, length_var_id);
+        t->alignment = elem_type->alignment;
 
-        // maybe handle larger types
-        u32 length = length_var->instruction->words[3];
-        
-        return calculate_type_size(elem_type, info) * length;
+        if (rules == spirv_layout_rules_std140 && t->alignment < 16)
+            t->alignment = 16;
+
+        t->stride = _get_array_stride_decoration(t, info);
+
+        if (t->stride == 0)
+        {
+            if (rules == spirv_layout_rules_scalar)
+                t->stride = (u32)elem_type->size;
+            else
+                t->stride = (u32)align_up(elem_type->size, t->alignment);
+        }
+
+        if (instr->opcode == SpvOpTypeArray)
+            t->size = (u64)t->stride * _get_array_length(t, info);
+
+        break;
     }
-    case SpvOpTypeRuntimeArray: return 0;
     case SpvOpTypeStruct:
     {
-        // returns the size of the last member + the offset of the last member.
-        // does not account for padding after the struct.
-
-        if (t->members.size == 0)
-            return 0;
-
-        spirv_struct_type_member *last_member = t->members.data;
-        u64 max_offset = 0;
+        u64 end = 0;
 
         for_array(mem, &t->members)
-        if (mem->offset > max_offset)
         {
-            max_offset = mem->offset;
-            last_member = mem;
-        }
+            spirv_type *mem_type = _get_type_by_id(info, mem->type_id);
+            _member_layout(mem, mem_type, info, rules);
 
-        if (max_offset > 0)
-        {
-            spirv_type *mem_type = _get_type_by_id(info, last_member->type_id);
+            if (mem->alignment > t->alignment)
+                t->alignment = mem->alignment;
+
+            if (!mem->explicit_offset)
+                mem->offset = align_up(end, mem->alignment);
 
-            return calculate_type_size(mem_type, info) + last_member->offset;
+            if (mem->offset + mem->size > end)
+                end = mem->offset + mem->size;
         }
-        else
-        {
-            u64 total_size = 0;
-            for_array(mem2, &t->members)
-            {
-                spirv_type *mem_type = _get_type_by_id(info, mem2->type_id);
-                total_size += mem_type->size;
-            }
 
-            return total_size;
+        if (rules == spirv_layout_rules_std140 && t->alignment < 16)
+            t->alignment = 16;
+
+        t->size = align_up(end, t->alignment);
+        break;
+    }
+    case SpvOpTypePointer:
+    {
+        // only physical pointers have a size
+        if (instr->words[2] == SPIRV_STORAGE_CLASS_PHYSICAL_STORAGE_BUFFER)
+        {
+            t->size = 8;
+            t->alignment = 8;
         }
+
+        break;
     }
-    case SpvOpTypeOpaque:       return 0;
-    case SpvOpTypePointer:      return 0;
-    case SpvOpTypeFunction:     return 0;
-    case SpvOpTypeEvent:        return 0;
-    case SpvOpTypeDeviceEvent:  return 0;
-    case SpvOpTypeReserveId:    return 0;
-    case SpvOpTypeQueue:        return 0;
-    case SpvOpTypePipe:         return 0;
-    case SpvOpTypePipeStorage:  return 0;
-    case SpvOpTypeNamedBarrier: return 0;
+
+    // bools have no defined layout, images, samplers etc. are opaque
     default:
-        return 0;
+        break;
     }
-
-    return 0;
 }
 
-void collect_type_information(spirv_info *info)
+void compute_type_layouts(spirv_info *info, spirv_layout_rules rules)
 {
-    // get type sizes
+    assert(info != nullptr);
+
+    info->layout_rules = rules;
+
     for_array(t, &info->types)
-        t->size = calculate_type_size(t, info);
+        _compute_type_layout(t, info, rules);
 }
 
-void print_extra_type_information_inline(spirv_type *t, spirv_info *info, u32 depth)
+void print_extra_type_information_inline(const spirv_trace_sink *trace, spirv_type *t, spirv_info *info, u32 depth)
 {
-    spirv_id_instruction *instr = t->instruction;
+    spirv_instruction *instr = &t->instruction;
 
     switch (instr->opcode)
     {
-    case SpvOpTypeVoid: printf("void"); break;
-    case SpvOpTypeBool: printf("bool"); break;
+    case SpvOpTypeVoid: _trace(trace, "void"); break;
+    case SpvOpTypeBool: _trace(trace, "bool"); break;
     case SpvOpTypeInt:
     {
         u32 width = instr->words[2];
         u32 sign  = instr->words[3];
 
         if (sign)
-            printf("s%d", width);
+            _trace(trace, "s%d", width);
         else
-            printf("u%d", width);
+            _trace(trace, "u%d", width);
         break;
     }
     case SpvOpTypeFloat:
@@ -325,64 +1467,64 @@ void print_extra_type_information_inline(spirv_type *t, spirv_info *info, u32 de
         u32 width = instr->words[2];
 
         if (width > 32)
-            printf("double");
+            _trace(trace, "double");
         else
-            printf("float");
+            _trace(trace, "float");
         break;
     }
     case SpvOpTypeVector:
     {
-        SpvId comp_id = (SpvId)t->instruction->words[2];
+        SpvId comp_id = (SpvId)t->instruction.words[2];
         spirv_type *comp_type = _get_type_by_id(info, comp_id);
-        u32 comp_count = t->instruction->words[3];
+        u32 comp_count = t->instruction.words[3];
 
-        printf("vec%u<", comp_count);
-        print_extra_type_information_inline(comp_type, info, depth+1);
-        printf(">");
+        _trace(trace, "vec%u<", comp_count);
+        print_extra_type_information_inline(trace, comp_type, info, depth+1);
+        _trace(trace, ">");
         break;
     }
     case SpvOpTypeMatrix:
     {
-        SpvId vec_id = (SpvId)t->instruction->words[2];
+        SpvId vec_id = (SpvId)t->instruction.words[2];
         spirv_type *vec_type = _get_type_by_id(info, vec_id);
-        u32 column_count = t->instruction->words[3];
+        u32 column_count = t->instruction.words[3];
 
-        SpvId comp_id = (SpvId)vec_type->instruction->words[2];
+        SpvId comp_id = (SpvId)vec_type->instruction.words[2];
         spirv_type *comp_type = _get_type_by_id(info, comp_id);
-        u32 row_count = vec_type->instruction->words[3];
+        u32 row_count = vec_type->instruction.words[3];
 
-        printf("mat%ux%u<", row_count, column_count);
-        print_extra_type_information_inline(comp_type, info, depth+1);
-        printf(">");
+        _trace(trace, "mat%ux%u<", row_count, column_count);
+        print_extra_type_information_inline(trace, comp_type, info, depth+1);
+        _trace(trace, ">");
         break;
     }
-    case SpvOpTypeImage: printf("image"); break;
-    case SpvOpTypeSampler: printf("sampler"); break;
-    case SpvOpTypeSampledImage: printf("sampled_image"); break;
+    case SpvOpTypeImage: _trace(trace, "image"); break;
+    case SpvOpTypeSampler: _trace(trace, "sampler"); break;
+    case SpvOpTypeSampledImage: _trace(trace, "sampled_image"); break;
     case SpvOpTypeArray:
     {
-        SpvId elem_type_id = (SpvId)t->instruction->words[2];
+        SpvId elem_type_id = (SpvId)t->instruction.words[2];
         spirv_type *elem_type = _get_type_by_id(info, elem_type_id);
 
-        SpvId length_var_id = (SpvId)t->instruction->words[3];
+        SpvId length_var_id = (SpvId)t->instruction.words[3];
         spirv_variable *length_var = _get_variable_by_id(info, length_var_id);
 
         // maybe handle larger types
-        u32 length = length_var->instruction->words[3];
+        u32 length = length_var->instruction.words[3];
         
-        print_extra_type_information_inline(elem_type, info, depth+1);
-        printf("[%u]", length);
+        print_extra_type_information_inline(trace, elem_type, info, depth+1);
+        _trace(trace, "[%u]", length);
 
         break;
     }
     case SpvOpTypeRuntimeArray:
     {
-        SpvId elem_type_id = (SpvId)t->instruction->words[2];
+        SpvId elem_type_id = (SpvId)t->instruction.words[2];
         spirv_type *elem_type = _get_type_by_id(info, elem_type_id);
         
-        printf("array<");
-        print_extra_type_information_inline(elem_type, info, depth+1);
-        printf(">");
+        _trace(trace, "array<");
+        print_extra_type_information_inline(trace, elem_type, info, depth+1);
+        _trace(trace, ">");
 
         break;
     }
@@ -390,78 +1532,78 @@ void print_extra_type_information_inline(spirv_type *t, spirv_info *info, u32 de
     {
         if (depth > 0)
         {
-            printf("%s", t->instruction->name);
+            _trace(trace, "%s", get_id_name(info, t->id));
             break;
         }
 
-        printf("struct %s\n{\n", t->instruction->name);
+        _trace(trace, "struct %s\n{\n", get_id_name(info, t->id));
 
         for_array(mem, &t->members)
         {
             spirv_type *mem_type = _get_type_by_id(info, mem->type_id);
-            printf("\t[offset %3lu, size %3lu]\t", mem->offset, mem_type->size);
-            print_extra_type_information_inline(mem_type, info, depth+1);
-            printf(" %s;\n", mem->name);
+            _trace(trace, "\t[offset %3lu, size %3lu]\t", mem->offset, mem->size);
+            print_extra_type_information_inline(trace, mem_type, info, depth+1);
+            _trace(trace, " %s;\n", mem->name);
         }
 
-        printf("}");
+        _trace(trace, "}");
         break;
     }
     case SpvOpTypeOpaque:
     {
-        const char *name = (const char *)t->instruction->words + 2;
+        const char *name = (const char *)t->instruction.words + 2;
 
-        printf("%s", name);
+        _trace(trace, "%s", name);
     }
     case SpvOpTypePointer:
     {
-        SpvStorageClass storage = (SpvStorageClass)t->instruction->words[2];
-        SpvId type_id = (SpvId)t->instruction->words[3];
+        SpvStorageClass storage = (SpvStorageClass)t->instruction.words[2];
+        SpvId type_id = (SpvId)t->instruction.words[3];
         spirv_type *type = _get_type_by_id(info, type_id);
 
         const char *storage_name = storage_class_name(storage);
 
-        printf("%s ", storage_name);
-        print_extra_type_information_inline(type, info, depth+1);
-        printf("*");
+        _trace(trace, "%s ", storage_name);
+        print_extra_type_information_inline(trace, type, info, depth+1);
+        _trace(trace, "*");
 
         break;
     }
-    case SpvOpTypeFunction: printf("function"); break;
-    case SpvOpTypeEvent: printf("event"); break;
-    case SpvOpTypeDeviceEvent: printf("device_event"); break;
-    case SpvOpTypeReserveId: printf("reserve_id"); break;
-    case SpvOpTypeQueue: printf("queue"); break;
-    case SpvOpTypePipe: printf("pipe"); break;
-    case SpvOpTypePipeStorage: printf("pipe_storage"); break;
-    case SpvOpTypeNamedBarrier: printf("named_barrier"); break;
+    case SpvOpTypeFunction: _trace(trace, "function"); break;
+    case SpvOpTypeEvent: _trace(trace, "event"); break;
+    case SpvOpTypeDeviceEvent: _trace(trace, "device_event"); break;
+    case SpvOpTypeReserveId: _trace(trace, "reserve_id"); break;
+    case SpvOpTypeQueue: _trace(trace, "queue"); break;
+    case SpvOpTypePipe: _trace(trace, "pipe"); break;
+    case SpvOpTypePipeStorage: _trace(trace, "pipe_storage"); break;
+    case SpvOpTypeNamedBarrier: _trace(trace, "named_barrier"); break;
         break;
     }
 }
 
-void print_extra_type_information(spirv_info *info)
+void print_extra_type_information(const spirv_trace_sink *trace, spirv_info *info)
 {
     for_array(t, &info->types)
     {
-        printf("%%%u [size %3lu]\t= ", t->instruction->id, t->size);
-        print_extra_type_information_inline(t, info, 0);
-        printf("\n");
+        _trace(trace, "%%%u [size %3lu, align %2u, stride %3u]\t= ", t->id, t->size, t->alignment, t->stride);
+        print_extra_type_information_inline(trace, t, info, 0);
+        _trace(trace, "\n");
     }
 }
 
-void handle_spirv_op_type(u64 i, spirv_type *type, const spirv_info *info)
+void handle_spirv_op_type(const spirv_trace_sink *trace, u64 i, spirv_type *type, const spirv_info *info)
 {
-    u32 bound = (u32)info->id_instructions.size;
-    spirv_id_instruction *id_instr = type->instruction;
-    printf(INSTR_ID_FMT " ", i, id_instr->id);
+    u32 bound = (u32)info->ids.opcodes.size;
+    const spirv_instruction *id_instr = &type->instruction;
+    _trace(trace, INSTR_ID_FMT " ", i, type->id);
 
     switch (id_instr->opcode)
     {
     case SpvOpTypeVoid:
-        printf("OpTypeVoid");
+        _trace(trace, "OpTypeVoid");
         break;
     case SpvOpTypeBool:
-        printf("OpTypeBool");
+        _trace(trace, "OpTypeBool");
         break;
     case SpvOpTypeInt:
     {
@@ -470,7 +1612,7 @@ void handle_spirv_op_type(u64 i, spirv_type *type, const spirv_info *info)
         u32 width = id_instr->words[2];
         u32 sign  = id_instr->words[3];
 
-        printf("OpTypeInt %u %u", width, sign);
+        _trace(trace, "OpTypeInt %u %u", width, sign);
 
         break;
     }
@@ -480,7 +1622,7 @@ void handle_spirv_op_type(u64 i, spirv_type *type, const spirv_info *info)
 
         u32 width = id_instr->words[2];
 
-        printf("OpTypeFloat %u", width);
+        _trace(trace, "OpTypeFloat %u", width);
 
         break;
     }
@@ -494,7 +1636,7 @@ void handle_spirv_op_type(u64 i, spirv_type *type, const spirv_info *info)
         u32 count = id_instr->words[3];
         assert(count >= 2);
 
-        printf("OpTypeVector %%%u %u", comp_id, count);
+        _trace(trace, "OpTypeVector %%%u %u", comp_id, count);
 
         break;
     }
@@ -508,7 +1650,7 @@ void handle_spirv_op_type(u64 i, spirv_type *type, const spirv_info *info)
         u32 column_count = id_instr->words[3];
         assert(column_count >= 2);
 
-        printf("OpTypeMatrix %%%u %u", column_type_id, column_count);
+        _trace(trace, "OpTypeMatrix %%%u %u", column_type_id, column_count);
 
         break;
     }
@@ -526,18 +1668,18 @@ void handle_spirv_op_type(u64 i, spirv_type *type, const spirv_info *info)
         u32 sampled = id_instr->words[7];
         SpvImageFormat format = (SpvImageFormat)id_instr->words[8];
 
-        printf("OpTypeImage %%%u %d %u %u %u %u %d", sampled_type_id, dim, depth, arrayed, multisampled, sampled, format);
+        _trace(trace, "OpTypeImage %%%u %d %u %u %u %u %d", sampled_type_id, dim, depth, arrayed, multisampled, sampled, format);
 
         if (id_instr->word_count >= 10)
         {
             SpvAccessQualifier access = (SpvAccessQualifier)(id_instr->words[9]);
-            printf(" %d", access);
+            _trace(trace, " %d", access);
         }
 
         break;
     }
     case SpvOpTypeSampler:
-        printf("OpTypeSampler");
+        _trace(trace, "OpTypeSampler");
         break;
     case SpvOpTypeSampledImage:
     {
@@ -546,7 +1688,7 @@ void handle_spirv_op_type(u64 i, spirv_type *type, const spirv_info *info)
         SpvId img_id = (SpvId)id_instr->words[2];
         assert(img_id < bound);
 
-        printf("OpTypeSampledImage %%%u", img_id);
+        _trace(trace, "OpTypeSampledImage %%%u", img_id);
         break;
     }
     case SpvOpTypeArray:
@@ -559,7 +1701,7 @@ void handle_spirv_op_type(u64 i, spirv_type *type, const spirv_info *info)
         SpvId length_id = (SpvId)id_instr->words[3];
         assert(length_id < bound);
 
-        printf("OpTypeArray %%%u %%%u", comp_id, length_id);
+        _trace(trace, "OpTypeArray %%%u %%%u", comp_id, length_id);
         break;
     }
     case SpvOpTypeRuntimeArray:
@@ -569,27 +1711,17 @@ void handle_spirv_op_type(u64 i, spirv_type *type, const spirv_info *info)
         SpvId comp_id = (SpvId)id_instr->words[2];
         assert(comp_id < bound);
 
-        printf("OpTypeRuntimeArray %%%u", comp_id);
+        _trace(trace, "OpTypeRuntimeArray %%%u", comp_id);
         break;
     }
     case SpvOpTypeStruct:
     {
         assert(id_instr->word_count >= 2);
 
-        printf("OpTypeStruct");
-
-        SpvId *member_ids = (SpvId*)(id_instr->words + 2);
-        u32 member_count = id_instr->word_count - 2;
-
-        ::reserve(&type->members, member_count);
-        type->members.size = member_count;
+        _trace(trace, "OpTypeStruct");
 
-        for (u32 mem_i = 0; mem_i < member_count; ++mem_i)
-        {
-            SpvId mem_id = member_ids[mem_i];
-            type->members[mem_i].type_id = mem_id;
-            printf(" %%%u", mem_id);
-        }
+        for_array(mem, &type->members)
+            _trace(trace, " %%%u", mem->type_id);
 
         break;
     }
@@ -599,7 +1731,7 @@ void handle_spirv_op_type(u64 i, spirv_type *type, const spirv_info *info)
 
         const char *opaque_type_name = (const char *)(id_instr->words + 2);
 
-        printf("OpTypeOpaque %s", opaque_type_name);
+        _trace(trace, "OpTypeOpaque %s", opaque_type_name);
 
         break;
     }
@@ -610,7 +1742,7 @@ void handle_spirv_op_type(u64 i, spirv_type *type, const spirv_info *info)
         SpvStorageClass storage = (SpvStorageClass)(id_instr->words[2]);
         SpvId type_id = (SpvId)(id_instr->words[3]);
 
-        printf("OpTypePointer %d %%%u", storage, type_id);
+        _trace(trace, "OpTypePointer %d %%%u", storage, type_id);
 
         break;
     }
@@ -620,7 +1752,7 @@ void handle_spirv_op_type(u64 i, spirv_type *type, const spirv_info *info)
 
         SpvId return_type_id = (SpvId)id_instr->words[2];
 
-        printf("OpTypeFunction %%%u", return_type_id);
+        _trace(trace, "OpTypeFunction %%%u", return_type_id);
 
         SpvId *param_ids = (SpvId*)(id_instr->words + 3);
         u32 param_count = id_instr->word_count - 3;
@@ -628,22 +1760,22 @@ void handle_spirv_op_type(u64 i, spirv_type *type, const spirv_info *info)
         for (u32 param_i = 0; param_i < param_count; ++param_i)
         {
             SpvId param_id = param_ids[param_i];
-            printf(" %%%u", param_id);
+            _trace(trace, " %%%u", param_id);
         }
 
         break;
     }
     case SpvOpTypeEvent:
-        printf("OpTypeEvent");
+        _trace(trace, "OpTypeEvent");
         break;
     case SpvOpTypeDeviceEvent:
-        printf("OpTypeDeviceEvent");
+        _trace(trace, "OpTypeDeviceEvent");
         break;
     case SpvOpTypeReserveId:
-        printf("OpTypeReserveId");
+        _trace(trace, "OpTypeReserveId");
         break;
     case SpvOpTypeQueue:
-        printf("OpTypeQueue");
+        _trace(trace, "OpTypeQueue");
         break;
     case SpvOpTypePipe:
     {
@@ -651,29 +1783,30 @@ void handle_spirv_op_type(u64 i, spirv_type *type, const spirv_info *info)
 
         SpvAccessQualifier access = (SpvAccessQualifier)(id_instr->words[2]);
 
-        printf("OpTypePipe %d", access);
+        _trace(trace, "OpTypePipe %d", access);
         break;
     }
     case SpvOpTypePipeStorage:
-        printf("OpTypePipeStorage");
+        _trace(trace, "OpTypePipeStorage");
         break;
     case SpvOpTypeNamedBarrier:
-        printf("OpTypeNamedBarrier");
+        _trace(trace, "OpTypeNamedBarrier");
         break;
     }
 
-    printf("\n");
+    _trace(trace, "\n");
 }
 
-void handle_spirv_op_variable(u64 i, spirv_id_instruction *id_instr, const spirv_info *info)
+void handle_spirv_op_variable(const spirv_trace_sink *trace, u64 i, spirv_variable *var, const spirv_info *info)
 {
-    u32 bound = (u32)info->id_instructions.size;
+    u32 bound = (u32)info->ids.opcodes.size;
+    const spirv_instruction *id_instr = &var->instruction;
     SpvId result_type_id = (SpvId)id_instr->words[1];
     assert(result_type_id < bound);
 
-    spirv_id_instruction *result_instr = info->id_instructions.data + result_type_id;
+    u16 result_opcode = info->ids.opcodes[result_type_id];
 
-    printf(INSTR_ID_FMT " ", i, id_instr->id);
+    _trace(trace, INSTR_ID_FMT " ", i, var->id);
 
     switch (id_instr->opcode)
     {
@@ -683,12 +1816,12 @@ void handle_spirv_op_variable(u64 i, spirv_id_instruction *id_instr, const spirv
 
         SpvStorageClass storage = (SpvStorageClass)(id_instr->words[3]);
 
-        printf("OpVariable %%%u %d", result_type_id, storage);
+        _trace(trace, "OpVariable %%%u %d", result_type_id, storage);
 
         if (id_instr->word_count > 4)
         {
             SpvId init_type = (SpvId)id_instr->words[4];
-            printf(" %%%u", init_type);
+            _trace(trace, " %%%u", init_type);
         }
 
         // maybe handle larger type constants
@@ -702,14 +1835,14 @@ void handle_spirv_op_variable(u64 i, spirv_id_instruction *id_instr, const spirv
         u32 *val = id_instr->words + 3;
 
         if (id_instr->opcode == SpvOpConstant)
-            printf("OpConstant %%%u", result_type_id);
+            _trace(trace, "OpConstant %%%u", result_type_id);
         else
-            printf("OpSpecConstant %%%u", result_type_id);
+            _trace(trace, "OpSpecConstant %%%u", result_type_id);
 
-        switch (result_instr->opcode)
+        switch (result_opcode)
         {
-        case SpvOpTypeInt:   printf(" %u", *val); break;
-        case SpvOpTypeFloat: printf(" %f", *(float*)(val)); break;
+        case SpvOpTypeInt:   _trace(trace, " %u", *val); break;
+        case SpvOpTypeFloat: _trace(trace, " %f", *(float*)(val)); break;
         default: break;
         }
 
@@ -717,13 +1850,13 @@ void handle_spirv_op_variable(u64 i, spirv_id_instruction *id_instr, const spirv
         break;
     }
     case SpvOpConstantNull:
-        printf("OpContantNull %%%u", result_type_id);
+        _trace(trace, "OpContantNull %%%u", result_type_id);
         break;
     case SpvOpConstantTrue:
-        printf("OpContantTrue %%%u", result_type_id);
+        _trace(trace, "OpContantTrue %%%u", result_type_id);
         break;
     case SpvOpConstantFalse:
-        printf("OpContantFalse %%%u", result_type_id);
+        _trace(trace, "OpContantFalse %%%u", result_type_id);
         break;
     case SpvOpConstantComposite:
     case SpvOpSpecConstantComposite:
@@ -731,9 +1864,9 @@ void handle_spirv_op_variable(u64 i, spirv_id_instruction *id_instr, const spirv
         assert(id_instr->word_count >= 3);
 
         if (id_instr->opcode == SpvOpConstantComposite)
-            printf("OpConstantComposite %%%u", result_type_id);
+            _trace(trace, "OpConstantComposite %%%u", result_type_id);
         else
-            printf("OpSpecConstantComposite %%%u", result_type_id);
+            _trace(trace, "OpSpecConstantComposite %%%u", result_type_id);
 
         SpvId *constituents_ids = (SpvId*)(id_instr->words + 3);
         u32 constituents_count = id_instr->word_count - 3;
@@ -741,7 +1874,7 @@ void handle_spirv_op_variable(u64 i, spirv_id_instruction *id_instr, const spirv
         for (u32 constituents_i = 0; constituents_i < constituents_count; ++constituents_i)
         {
             SpvId constituents_id = constituents_ids[constituents_i];
-            printf(" %%%u", constituents_id);
+            _trace(trace, " %%%u", constituents_id);
         }
 
         break;
@@ -754,7 +1887,7 @@ void handle_spirv_op_variable(u64 i, spirv_id_instruction *id_instr, const spirv
         u32 normalized = id_instr->words[4];
         SpvSamplerFilterMode filter = (SpvSamplerFilterMode)id_instr->words[5];
 
-        printf("OpConstantSampler %%%u %d %u %d", result_type_id, addr_mode, normalized, filter);
+        _trace(trace, "OpConstantSampler %%%u %d %u %d", result_type_id, addr_mode, normalized, filter);
         break;
     }
     case SpvOpSpecConstantOp:
@@ -766,163 +1899,163 @@ void handle_spirv_op_variable(u64 i, spirv_id_instruction *id_instr, const spirv
         u32 *operands = id_instr->words + 4;
         u32 operand_count = id_instr->word_count - 4;
 
-        printf("OpSpecConstantOp %%%u %u", result_type_id, opcode);
+        _trace(trace, "OpSpecConstantOp %%%u %u", result_type_id, opcode);
 
         for (u32 op_i = 0; op_i < operand_count; ++op_i)
-            printf(" %u", operands[op_i]);
+            _trace(trace, " %u", operands[op_i]);
 
         break;
     }
     case SpvOpSpecConstantTrue:
-        printf("OpSpecContantTrue %%%u", result_type_id);
+        _trace(trace, "OpSpecContantTrue %%%u", result_type_id);
         break;
     case SpvOpSpecConstantFalse:
-        printf("OpSpecContantFalse %%%u", result_type_id);
+        _trace(trace, "OpSpecContantFalse %%%u", result_type_id);
         break;
     default: 
         break;
     }
 
-    printf("\n");
+    _trace(trace, "\n");
 }
 
-void handle_spirv_decoration(u32 *words, u32 word_count, SpvDecoration decoration, const spirv_info *info)
+void handle_spirv_decoration(const spirv_trace_sink *trace, u32 *words, u32 word_count, SpvDecoration decoration, const spirv_info *info)
 {
     switch (decoration)
     {
-    case SpvDecorationRelaxedPrecision: printf(" RelaxedPrecision"); break;
+    case SpvDecorationRelaxedPrecision: _trace(trace, " RelaxedPrecision"); break;
     case SpvDecorationSpecId:
     {
         assert(word_count == 1);
         u32 spec_id = words[0];
-        printf(" SpecId %u", spec_id);
+        _trace(trace, " SpecId %u", spec_id);
         break;
     }
-    case SpvDecorationBlock: printf(" Block"); break;
-    case SpvDecorationBufferBlock: printf(" BufferBlock"); break;
-    case SpvDecorationRowMajor: printf(" RowMajor"); break;
-    case SpvDecorationColMajor: printf(" ColMajor"); break;
+    case SpvDecorationBlock: _trace(trace, " Block"); break;
+    case SpvDecorationBufferBlock: _trace(trace, " BufferBlock"); break;
+    case SpvDecorationRowMajor: _trace(trace, " RowMajor"); break;
+    case SpvDecorationColMajor: _trace(trace, " ColMajor"); break;
     case SpvDecorationArrayStride: 
     {
         assert(word_count == 1);
         u32 stride = words[0];
-        printf(" ArrayStride %u", stride);
+        _trace(trace, " ArrayStride %u", stride);
         break;
     }
     case SpvDecorationMatrixStride:
     {
         assert(word_count == 1);
         u32 stride = words[0];
-        printf(" MatrixStride %u", stride);
+        _trace(trace, " MatrixStride %u", stride);
         break;
     }
-    case SpvDecorationGLSLShared: printf(" GLSLShared"); break;
-    case SpvDecorationGLSLPacked: printf(" GLSLPacked"); break;
-    case SpvDecorationCPacked: printf(" CPacked"); break;
+    case SpvDecorationGLSLShared: _trace(trace, " GLSLShared"); break;
+    case SpvDecorationGLSLPacked: _trace(trace, " GLSLPacked"); break;
+    case SpvDecorationCPacked: _trace(trace, " CPacked"); break;
     case SpvDecorationBuiltIn:
     {
         assert(word_count == 1);
         SpvBuiltIn builtin = (SpvBuiltIn)words[0];
-        printf(" BuiltIn %d", builtin);
-        break;
-    }
-    case SpvDecorationNoPerspective: printf(" NoPerspective"); break;
-    case SpvDecorationFlat: printf(" Flat"); break;
-    case SpvDecorationPatch: printf(" Patch"); break;
-    case SpvDecorationCentroid: printf(" Centroid"); break;
-    case SpvDecorationSample: printf(" Sample"); break;
-    case SpvDecorationInvariant: printf(" Invariant"); break;
-    case SpvDecorationRestrict: printf(" Restrict"); break;
-    case SpvDecorationAliased: printf(" Aliased"); break;
-    case SpvDecorationVolatile: printf(" Volatile"); break;
-    case SpvDecorationConstant: printf(" Constant"); break;
-    case SpvDecorationCoherent: printf(" Coherent"); break;
-    case SpvDecorationNonWritable: printf(" NonWritable"); break;
-    case SpvDecorationNonReadable: printf(" NonReadable"); break;
-    case SpvDecorationUniform: printf(" Uniform"); break;
-    case SpvDecorationSaturatedConversion: printf(" SaturatedConversion"); break;
+        _trace(trace, " BuiltIn %d", builtin);
+        break;
+    }
+    case SpvDecorationNoPerspective: _trace(trace, " NoPerspective"); break;
+    case SpvDecorationFlat: _trace(trace, " Flat"); break;
+    case SpvDecorationPatch: _trace(trace, " Patch"); break;
+    case SpvDecorationCentroid: _trace(trace, " Centroid"); break;
+    case SpvDecorationSample: _trace(trace, " Sample"); break;
+    case SpvDecorationInvariant: _trace(trace, " Invariant"); break;
+    case SpvDecorationRestrict: _trace(trace, " Restrict"); break;
+    case SpvDecorationAliased: _trace(trace, " Aliased"); break;
+    case SpvDecorationVolatile: _trace(trace, " Volatile"); break;
+    case SpvDecorationConstant: _trace(trace, " Constant"); break;
+    case SpvDecorationCoherent: _trace(trace, " Coherent"); break;
+    case SpvDecorationNonWritable: _trace(trace, " NonWritable"); break;
+    case SpvDecorationNonReadable: _trace(trace, " NonReadable"); break;
+    case SpvDecorationUniform: _trace(trace, " Uniform"); break;
+    case SpvDecorationSaturatedConversion: _trace(trace, " SaturatedConversion"); break;
     case SpvDecorationStream:
     {
         assert(word_count == 1);
         u32 stream = words[0];
-        printf(" Stream %u", stream);
+        _trace(trace, " Stream %u", stream);
         break;
     }
     case SpvDecorationLocation: 
     {
         assert(word_count == 1);
         u32 location = words[0];
-        printf(" Location %u", location);
+        _trace(trace, " Location %u", location);
         break;
     }
     case SpvDecorationComponent:
     {
         assert(word_count == 1);
         u32 component = words[0];
-        printf(" Component %u", component);
+        _trace(trace, " Component %u", component);
         break;
     }
     case SpvDecorationIndex:
     {
         assert(word_count == 1);
         u32 index = words[0];
-        printf(" Index %u", index);
+        _trace(trace, " Index %u", index);
         break;
     }
     case SpvDecorationBinding:
     {
         assert(word_count == 1);
         u32 binding = words[0];
-        printf(" Binding %u", binding);
+        _trace(trace, " Binding %u", binding);
         break;
     }
     case SpvDecorationDescriptorSet:
     {
         assert(word_count == 1);
         u32 set = words[0];
-        printf(" DescriptorSet %u", set);
+        _trace(trace, " DescriptorSet %u", set);
         break;
     }
     case SpvDecorationOffset:
     {
         assert(word_count == 1);
         u32 offset = words[0];
-        printf(" Offset %u", offset);
+        _trace(trace, " Offset %u", offset);
         break;
     }
-    case SpvDecorationXfbBuffer: printf(" XfbBuffer"); break;
+    case SpvDecorationXfbBuffer: _trace(trace, " XfbBuffer"); break;
     {
         assert(word_count == 1);
         u32 buffer = words[0];
-        printf(" XfbBuffer %u", buffer);
+        _trace(trace, " XfbBuffer %u", buffer);
         break;
     }
-    case SpvDecorationXfbStride: printf(" XfbStride"); break;
+    case SpvDecorationXfbStride: _trace(trace, " XfbStride"); break;
     {
         assert(word_count == 1);
         u32 stride = words[0];
-        printf(" XfbStride %u", stride);
+        _trace(trace, " XfbStride %u", stride);
         break;
     }
     case SpvDecorationFuncParamAttr:
     {
         assert(word_count == 1);
         SpvFunctionParameterAttribute attr = (SpvFunctionParameterAttribute)words[0];
-        printf(" FuncParamAttr %d", attr);
+        _trace(trace, " FuncParamAttr %d", attr);
         break;
     }
     case SpvDecorationFPRoundingMode:
     {
         assert(word_count == 1);
         SpvFPRoundingMode mode = (SpvFPRoundingMode)words[0];
-        printf(" FPRoundingMode %d", mode);
+        _trace(trace, " FPRoundingMode %d", mode);
         break;
     }
     case SpvDecorationFPFastMathMode:
     {
         assert(word_count == 1);
         SpvFPFastMathModeMask mode = (SpvFPFastMathModeMask)words[0];
-        printf(" FPFastMathMode %d", mode);
+        _trace(trace, " FPFastMathMode %d", mode);
         break;
     }
     case SpvDecorationLinkageAttributes:
@@ -934,53 +2067,98 @@ void handle_spirv_decoration(u32 *words, u32 word_count, SpvDecoration decoratio
         // Screw you khronos.
         const char *name = (const char *)words;
 
-        printf(" LinkageAttributes %s ?", name);
+        _trace(trace, " LinkageAttributes %s ?", name);
         break;
     }
-    case SpvDecorationInputAttachmentIndex: printf(" "); break;
+    case SpvDecorationInputAttachmentIndex: _trace(trace, " "); break;
     {
         assert(word_count == 1);
         u32 index = words[0];
-        printf(" InputAttachmentIndex %u", index);
+        _trace(trace, " InputAttachmentIndex %u", index);
         break;
     }
     case SpvDecorationAlignment:
     {
         assert(word_count == 1);
         u32 align = words[0];
-        printf(" Alignment %u", align);
+        _trace(trace, " Alignment %u", align);
         break;
     }
     case SpvDecorationMaxByteOffset:
     {
         assert(word_count == 1);
         u32 offset = words[0];
-        printf(" MaxByteOffset %u", offset);
+        _trace(trace, " MaxByteOffset %u", offset);
         break;
     }
     case SpvDecorationAlignmentId:
     {
         assert(word_count == 1);
         SpvId id = (SpvId)words[0];
-        printf(" AlignmentId %d", id);
+        _trace(trace, " AlignmentId %d", id);
         break;
     }
     case SpvDecorationMaxByteOffsetId:
     {
         assert(word_count == 1);
         SpvId id = (SpvId)words[0];
-        printf(" MaxByteOffsetId %d", id);
+        _trace(trace, " MaxByteOffsetId %d", id);
         break;
     }
     default: break;
     }
 }
 
-bool parse_spirv_from_memory(memory_stream *input, spirv_info *output, error *err)
+// converts the module in output->data to native endianness in one pass.
+// the input is never written to, it may be read-only (a file mapping) or
+// shared with other threads. the words are swapped into the arena, or
+// output->owned_data without arena. a file read or mapped by
+// parse_spirv_from_file is released since nothing points into it anymore.
+static void _swap_module(spirv_info *output)
+{
+    memory_stream *data = &output->data;
+    u64 word_count = data->size / sizeof(u32);
+
+    output->byteswapped = true;
+
+    memory_stream swapped{};
+    swapped.size = word_count * sizeof(u32);
+
+    _count_allocation(swapped.size);
+
+    if (output->use_arena)
+    {
+        swapped.data = (char*)allocate<u32>(&output->arena, word_count);
+        output->data_in_arena = true;
+    }
+    else
+        ::open(&swapped, swapped.size);
+
+    ::byteswap_words((u32*)swapped.data, (u32*)data->data, word_count);
+
+    if (output->owned_data.data != nullptr)
+        ::close(&output->owned_data);
+
+    if (output->mapping.data != nullptr)
+        ::unmap_file(&output->mapping);
+
+    if (!output->use_arena)
+        output->owned_data = swapped;
+
+    *data = swapped;
+}
+
+bool parse_spirv_from_memory(memory_stream *input, spirv_info *output, error *err, const spirv_parse_options *options)
 {
     assert(input != nullptr);
     assert(output != nullptr);
 
+    const spirv_trace_sink *trace = options != nullptr ? &options->trace : &_null_trace_sink;
+
+    _phase_clock clock{};
+    _start_phase_clock(&clock, options != nullptr ? options->stats : nullptr);
+    defer { _phase_stats = nullptr; };
+
     if (input->size < 20)
     {
         get_spirv_parse_error(err, "input file too small");
@@ -988,14 +2166,28 @@ bool parse_spirv_from_memory(memory_stream *input, spirv_info *output, error *er
     }
 
     output->data = *input;
+    output->use_arena = options != nullptr && options->use_arena;
+
+    if (output->use_arena)
+        ::init(&output->arena, options->arena_block_size);
 
     u32 magic;
 
     read(input, &magic);
 
+    if (magic == SPIRV_SWAPPED_MAGIC_NUMBER)
+    {
+        _swap_module(output);
+
+        // output->data holds the converted module from here on
+        input = &output->data;
+        input->position = sizeof(u32);
+        magic = SpvMagicNumber;
+    }
+
     if (magic != SpvMagicNumber)
     {
-        get_spirv_parse_error(err, "invalid magic number, expected %u but got %u\n", magic);
+        get_spirv_parse_error(err, "invalid magic number, expected %u but got %u", SpvMagicNumber, magic);
         return false;
     }
 
@@ -1008,173 +2200,222 @@ bool parse_spirv_from_memory(memory_stream *input, spirv_info *output, error *er
     read(input, &gen_magic);
     read(input, &bound);
 
-    printf("version:         %u.%u (%08x)\n", (version >> 16) & 0xff, (version >> 8) & 0xff, version);
-    printf("generator magic: %08x\n", gen_magic);
-    printf("bound:           %u\n", bound);
+    spirv_trace(trace, spirv_trace_level_sections, "version:         %u.%u (%08x)\n", (version >> 16) & 0xff, (version >> 8) & 0xff, version);
+    spirv_trace(trace, spirv_trace_level_sections, "generator magic: %08x\n", gen_magic);
+    spirv_trace(trace, spirv_trace_level_sections, "bound:           %u\n", bound);
+
+    output->version = version;
 
-    ::resize(&output->id_instructions, bound);
-    ::fill_memory(output->id_instructions.data, 0, output->id_instructions.size);
+    input->position += sizeof(u32);
+
+    bool validate = options != nullptr && options->validate;
 
-    for_array(i, _idinstr, &output->id_instructions)
+    if (validate)
     {
-        init(_idinstr);
-        _idinstr->id = (SpvId)i;
-    }
+        if (input->size % sizeof(u32) != 0)
+        {
+            get_spirv_parse_error(err, "input size %lu is not a multiple of 4", input->size);
+            return false;
+        }
 
-    array<spirv_instruction> instructions{};
-    defer { ::free(&instructions); };
+        if (bound > SPIRV_MAX_BOUND)
+        {
+            get_spirv_parse_error(err, "bound %u exceeds the limit of %u", bound, SPIRV_MAX_BOUND);
+            return false;
+        }
+    }
 
-    input->position += sizeof(u32);
+    // sizing pass, only reads instruction headers unless validating
+    spirv_module_counts counts{};
 
-    while (!::is_at_end(input))
+    if (validate)
     {
-        spirv_instruction instr{};
+        if (!_count_module<true>(*input, &counts, bound, err))
+            return false;
+    }
+    else
+        _count_module<false>(*input, &counts, bound, err);
 
-        instr.words = (u32*)::current(input);
-        read(input, &instr.opcode);
-        read(input, &instr.word_count);
+    if (output->use_arena)
+        ::reserve(&output->arena, _estimate_arena_size(&counts, bound));
 
-        assert(instr.word_count >= 1);
-        input->position += sizeof(u32) * (instr.word_count - 1);
-        ::add_at_end(&instructions, instr);
-    }
+    _init_id_table(output, bound);
+
+    _reserve_exact(&output->entry_points, counts.entry_points, output);
+    _reserve_exact(&output->types, counts.types, output);
+    _reserve_exact(&output->variables, counts.variables, output);
+    _reserve_exact(&output->decorations, counts.decorations, output);
+    _reserve_exact(&output->functions, counts.functions, output);
+
+    // the sections are walked in a single pass straight over the stream,
+    // instructions are never collected.
+    spirv_instruction_cursor cur{};
+    init(&cur, input);
 
-    if (instructions.size <= 0)
+    if (!cur.valid)
     {
         get_spirv_parse_error(err, "no instructions");
         return false;
     }
 
-    u64 instruction_count = instructions.size;
-
     // https://registry.khronos.org/SPIR-V/specs/unified1/SPIRV.html#_logical_layout_of_a_module
     // The spec really is nonsense, they could've trivially added delimiters between
     // sections, put section information at the start or even just made the opcodes
     // sequential so you can simply check if an opcode is within the range of a
     // section, but no.
 
-    spirv_instruction *instr;
-    u64 i = 0;
+    spirv_instruction *instr = &cur.instruction;
+    const spirv_opcode_info *op = nullptr;
     bool breakout = false;
 
-    printf("\nMode Setting\n");
+    // offset of the current instruction, or the end
+#define cursor_offset() \
+    (cur.valid ? (u64)((char*)instr->words - input->data) : input->size)
 
-    // 1. OpCapability
-    for (; i < instruction_count; ++i)
+    _next_phase(&clock, spirv_parse_phase_mode_setting, cur.index, cursor_offset());
+
+    if (clock.stats != nullptr)
     {
-        instr = instructions.data + i;
+        // the sizing pass walks every instruction header
+        clock.stats->phases[spirv_parse_phase_header].instructions = counts.instructions;
+        clock.stats->phases[spirv_parse_phase_header].bytes = input->size;
+    }
 
-        if (instr->opcode != SpvOpCapability)
-            break;
+    // one table lookup per instruction decides whether it belongs to the
+    // current section
+#define in_section(SECTION) \
+    (op = get_spirv_opcode_info(instr->opcode), _check_instruction(instr, op, bound), op->section == (SECTION))
+
+    spirv_trace(trace, spirv_trace_level_sections, "\nMode Setting\n");
 
-        assert(instr->word_count == 2);
+    // 1. OpCapability
+    for (; cur.valid; advance(&cur))
+    {
+        if (!in_section(spirv_section_capability))
+            break;
 
         SpvCapability cap = (SpvCapability)instr->words[1];
-        printf(INSTR_FMT " OpCapability %d\n", i, cap);
+        spirv_trace(trace, spirv_trace_level_instructions, INSTR_FMT " OpCapability %d\n", cur.index, cap);
     }
 
     // 2. OpExtension
-    for (; i < instruction_count; ++i)
+    for (; cur.valid; advance(&cur))
     {
-        instr = instructions.data + i;
-
-        if (instr->opcode != SpvOpExtension)
+        if (!in_section(spirv_section_extension))
             break;
 
-        assert(instr->word_count >= 2);
-
         const char *name = (const char *)(instr->words + 1);
-        printf(INSTR_FMT " OpExtension %s\n", i, name);
+        spirv_trace(trace, spirv_trace_level_instructions, INSTR_FMT " OpExtension %s\n", cur.index, name);
     }
 
     // 3. OpExtInstImport
-    for (; i < instruction_count; ++i)
+    for (; cur.valid; advance(&cur))
     {
-        instr = instructions.data + i;
-
-        if (instr->opcode != SpvOpExtInstImport)
+        if (!in_section(spirv_section_ext_inst_import))
             break;
 
-        assert(instr->word_count >= 3);
-
         u32 id = instr->words[1];
         const char *name = (const char *)(instr->words + 2);
 
-        ::copy_memory(instr, output->id_instructions.data + id, sizeof(spirv_instruction));
+        if (!_define_id(output, id, instr, validate, cur.index, err))
+            return false;
 
-        printf(INSTR_ID_FMT " OpExtInstImport %s\n", i, id, name);
+        spirv_trace(trace, spirv_trace_level_instructions, INSTR_ID_FMT " OpExtInstImport %s\n", cur.index, id, name);
     }
 
     // 4. OpMemoryModel (required)
-    if (i >= instruction_count || instr->opcode != SpvOpMemoryModel)
+    if (!cur.valid || !in_section(spirv_section_memory_model))
     {
         get_spirv_parse_error(err, "required OpMemoryModel instruction not found");
         return false;
     }
 
-    assert(instr->word_count == 3);
-
     output->addressing_model = (SpvAddressingModel)instr->words[1];
     output->memory_model = (SpvMemoryModel)instr->words[2];
 
-    printf(INSTR_FMT " OpMemoryModel %d %d\n", i, output->addressing_model, output->memory_model);
-    i++;
+    spirv_trace(trace, spirv_trace_level_instructions, INSTR_FMT " OpMemoryModel %d %d\n", cur.index, output->addressing_model, output->memory_model);
+    advance(&cur);
 
     // 5. OpEntryPoint
-    for (; i < instruction_count; ++i)
+    for (; cur.valid; advance(&cur))
     {
-        instr = instructions.data + i;
-
-        if (instr->opcode != SpvOpEntryPoint)
+        if (!in_section(spirv_section_entry_point))
             break;
 
-        assert(instr->word_count >= 4);
-
         SpvId id = (SpvId)instr->words[2];
         assert(id < bound);
 
-        spirv_id_instruction *id_instr = output->id_instructions.data + id;
-
-        // ::copy_memory(instr, id_instr, sizeof(spirv_instruction));
-
         spirv_entry_point *ep = ::add_at_end(&output->entry_points);
         ::init(ep);
 
-        ep->instruction = id_instr;
+        ep->id = id;
         ep->execution_model = (SpvExecutionModel)instr->words[1];
         ep->name = (const char *)(instr->words + 3);
         // why is name not last??????????
-        u64 name_wordlen = ((string_length(ep->name) + 3) / 4);
+        // the name includes its null terminator, padded to whole words
+        u64 name_wordlen = (string_length(ep->name) / 4) + 1;
 
-        assert(name_wordlen + 4 < instr->word_count);
+        assert(name_wordlen + 3 <= instr->word_count);
 
-        ep->ref_count = (instr->word_count - 4) - name_wordlen;
-        ep->refs = instr->words + 5;
+        ep->ref_count = (u16)((instr->word_count - 3) - name_wordlen);
+        ep->refs = instr->words + 3 + name_wordlen;
 
-        printf(INSTR_FMT " OpEntryPoint %d %%%u %s", i, ep->execution_model, id, ep->name);
+        if (spirv_trace_enabled(trace, spirv_trace_level_instructions))
+        {
+            _trace(trace, INSTR_FMT " OpEntryPoint %d %%%u %s", cur.index, ep->execution_model, id, ep->name);
 
-        for (u32 ref = 0; ref < ep->ref_count; ++ref)
-            printf(" %%%u", ep->refs[ref]);
-        printf("\n");
+            for (u32 ref = 0; ref < ep->ref_count; ++ref)
+                _trace(trace, " %%%u", ep->refs[ref]);
+            _trace(trace, "\n");
+        }
     }
 
-    // 6. OpExecutionMode / OpExecutionModeId
-    for (; i < instruction_count; ++i)
+    // execution modes directly follow the entry points, look ahead and
+    // count them per entry point so every array is allocated once.
     {
-        instr = instructions.data + i;
+        memory_stream ahead_stream = *input;
+        spirv_instruction_cursor ahead = cur;
+        ahead.stream = &ahead_stream;
 
-        if (instr->opcode != SpvOpExecutionMode
-         && instr->opcode != SpvOpExecutionModeId)
-            break;
+        for (; ahead.valid; advance(&ahead))
+        {
+            spirv_instruction *ainstr = &ahead.instruction;
+
+            if (ainstr->opcode != SpvOpExecutionMode
+             && ainstr->opcode != SpvOpExecutionModeId)
+                break;
+
+            if (ainstr->word_count < 3)
+                continue;
+
+            spirv_entry_point *ep = get_entry_point_by_id(output, (SpvId)ainstr->words[1]);
+
+            if (ep != nullptr)
+                ep->execution_modes.size++;
+        }
+
+        for_array(ep, &output->entry_points)
+        {
+            u64 mode_count = ep->execution_modes.size;
+            ep->execution_modes.size = 0;
+
+            if (mode_count > 0)
+                _reserve_exact(&ep->execution_modes, mode_count, output);
+        }
+    }
 
-        assert(instr->word_count >= 3);
+    // 6. OpExecutionMode / OpExecutionModeId
+    for (; cur.valid; advance(&cur))
+    {
+        if (!in_section(spirv_section_execution_mode))
+            break;
 
         SpvId id = (SpvId)instr->words[1];
         spirv_entry_point *ep = get_entry_point_by_id(output, id);
 
         if (ep == nullptr)
         {
-            get_spirv_parse_error(err, INSTR_FMT " invalid OpExecutionMode entry point %u", i, id);
+            get_spirv_parse_error(err, INSTR_FMT " invalid OpExecutionMode entry point %u", cur.index, id);
             return false;
         }
 
@@ -1184,86 +2425,77 @@ bool parse_spirv_from_memory(memory_stream *input, spirv_info *output, error *er
         exec->words = instr->words + 3;
         exec->word_count = instr->word_count - 3;
 
-        printf(INSTR_FMT " OpExecutionMode %u %d\n", i, id, exec->execution_mode);
+        spirv_trace(trace, spirv_trace_level_instructions, INSTR_FMT " OpExecutionMode %u %d\n", cur.index, id, exec->execution_mode);
     }
 
-    printf("\nDebug Information\n");
+    _next_phase(&clock, spirv_parse_phase_debug, cur.index, cursor_offset());
+
+    spirv_trace(trace, spirv_trace_level_sections, "\nDebug Information\n");
 
     // 7. Debug instructions
     // 7.a String & Sources
-    for (; i < instruction_count; ++i)
+    for (; cur.valid; advance(&cur))
     {
-        instr = instructions.data + i;
-
-        if (instr->opcode != SpvOpString
-         && instr->opcode != SpvOpSource
-         && instr->opcode != SpvOpSourceExtension
-         && instr->opcode != SpvOpSourceContinued
-         )
+        if (!in_section(spirv_section_debug_source))
             break;
 
         switch (instr->opcode)
         {
         case SpvOpString:
         {
-            assert(instr->word_count >= 3);
             SpvId id = (SpvId)instr->words[1];
-
-            assert(id < bound);
-
             const char *value = (const char *)(instr->words + 2);
 
-            ::copy_memory(instr, output->id_instructions.data + id, sizeof(spirv_instruction));
+            if (!_define_id(output, id, instr, validate, cur.index, err))
+                return false;
 
-            printf(INSTR_ID_FMT " OpString \"%s\"\n", i, id, value);
+            spirv_trace(trace, spirv_trace_level_instructions, INSTR_ID_FMT " OpString \"%s\"\n", cur.index, id, value);
             break;
         };
 
         case SpvOpSource:
         {
-            assert(instr->word_count >= 3);
             SpvSourceLanguage lang = (SpvSourceLanguage)instr->words[1];
             u32 sourcever = instr->words[2];
 
-            printf(INSTR_FMT " OpSource %d %u", i, lang, sourcever);
+            if (!spirv_trace_enabled(trace, spirv_trace_level_instructions))
+                break;
+
+            _trace(trace, INSTR_FMT " OpSource %d %u", cur.index, lang, sourcever);
 
             if (instr->word_count >= 4)
             {
                 SpvId fileid = (SpvId)instr->words[3];
                 assert(fileid < bound);
 
-                printf(" %%%u", fileid);
+                _trace(trace, " %%%u", fileid);
             }
 
             if (instr->word_count >= 5)
             {
                 const char *source = (const char *)(instr->words + 4);
 
-                printf(" %s", source);
+                _trace(trace, " %s", source);
             }
 
-            printf("\n");
+            _trace(trace, "\n");
 
             break;
         };
 
         case SpvOpSourceExtension:
         {
-            assert(instr->word_count >= 2);
-
             const char *ext = (const char *)(instr->words + 1);
 
-            printf(INSTR_FMT " OpSourceExtension %s\n", i, ext);
+            spirv_trace(trace, spirv_trace_level_instructions, INSTR_FMT " OpSourceExtension %s\n", cur.index, ext);
             break;
         };
 
         case SpvOpSourceContinued:
         {
-            assert(instr->word_count >= 2);
-
             const char *cont = (const char *)(instr->words + 1);
 
-            printf(INSTR_FMT " OpSourceContinued %s\n", i, cont);
+            spirv_trace(trace, spirv_trace_level_instructions, INSTR_FMT " OpSourceContinued %s\n", cur.index, cont);
             break;
         };
 
@@ -1274,49 +2506,42 @@ bool parse_spirv_from_memory(memory_stream *input, spirv_info *output, error *er
 
     // we remember member name indices for debug information instructions
     // because at this point there are no types / members to write to.
-    array<u64> member_name_idxs{};
-    defer { free(&member_name_idxs); };
+    array<spirv_instruction> member_names{};
+    defer { if (!output->use_arena) free(&member_names); };
+    _reserve_exact(&member_names, counts.member_names, output);
 
     // 7.b OpName and OpMemberName
-    for (; i < instruction_count; ++i)
+    for (; cur.valid; advance(&cur))
     {
-        instr = instructions.data + i;
-
-        if (instr->opcode != SpvOpName
-         && instr->opcode != SpvOpMemberName
-         )
+        if (!in_section(spirv_section_debug_name))
             break;
 
         switch (instr->opcode)
         {
         case SpvOpName:
         {
-            assert(instr->word_count >= 3);
             SpvId id = (SpvId)instr->words[1];
             assert(id < bound);
 
-            spirv_id_instruction *idinstr = output->id_instructions.data + id;
-
             const char *name = (const char *)(instr->words + 2);
 
-            idinstr->name = name;
+            output->ids.names[id] = name;
 
-            printf(INSTR_FMT " OpName %%%u \"%s\"\n", i, id, name);
+            spirv_trace(trace, spirv_trace_level_instructions, INSTR_FMT " OpName %%%u \"%s\"\n", cur.index, id, name);
 
             break;
         }
 
         case SpvOpMemberName:
         {
-            assert(instr->word_count >= 4);
             SpvId id = (SpvId)instr->words[1];
             assert(id < bound);
 
             u32 member = instr->words[2];
             const char *member_name = (const char *)(instr->words + 3);
-            printf(INSTR_FMT " OpMemberName %%%u %u \"%s\"\n", i, id, member, member_name);
+            spirv_trace(trace, spirv_trace_level_instructions, INSTR_FMT " OpMemberName %%%u %u \"%s\"\n", cur.index, id, member, member_name);
 
-            ::add_at_end(&member_name_idxs, i);
+            ::add_at_end(&member_names, instr);
 
             break;
         }
@@ -1327,254 +2552,254 @@ bool parse_spirv_from_memory(memory_stream *input, spirv_info *output, error *er
     }
 
     // 7.c OpModuleProcessed
-    for (; i < instruction_count; ++i)
+    for (; cur.valid; advance(&cur))
     {
-        instr = instructions.data + i;
-
-        if (instr->opcode != SpvOpModuleProcessed)
+        if (!in_section(spirv_section_module_processed))
             break;
 
-        assert(instr->word_count >= 2);
-
         const char *process = (const char *)(instr->words + 1);
-        printf(INSTR_FMT " OpModuleProcessed %s\n", i, process);
-        break;
+        spirv_trace(trace, spirv_trace_level_instructions, INSTR_FMT " OpModuleProcessed %s\n", cur.index, process);
     }
 
-    printf("\nDecorations\n");
+    _next_phase(&clock, spirv_parse_phase_decorations, cur.index, cursor_offset());
+
+    spirv_trace(trace, spirv_trace_level_sections, "\nDecorations\n");
 
     // once again, since types are defined later (thanks khronos), we
     // have to remember the member decoration indices and handle them
     // later.
-    array<u64> member_decor_idxs{};
-    defer { free(&member_decor_idxs); };
+    array<spirv_instruction> member_decorations{};
+    defer { if (!output->use_arena) free(&member_decorations); };
+    _reserve_exact(&member_decorations, counts.member_decorations, output);
 
     // 8. Decorations
-    for (; i < instruction_count; ++i)
+    for (; cur.valid; advance(&cur))
     {
-        instr = instructions.data + i;
+        if (!in_section(spirv_section_annotation))
+            break;
 
         switch (instr->opcode)
         {
         case SpvOpDecorate:
         {
-            assert(instr->word_count >= 3);
             ::add_at_end(&output->decorations, *instr);
             
             SpvId target_id = (SpvId)instr->words[1];
             assert(target_id < bound);
 
-            spirv_id_instruction *target_instr = output->id_instructions.data + target_id;
-            ::insert_element(&target_instr->decoration_indices, (u32)output->decorations.size-1);
-
-            printf(INSTR_FMT " OpDecorate %%%u", i, target_id);
+            if (spirv_trace_enabled(trace, spirv_trace_level_instructions))
+            {
+                _trace(trace, INSTR_FMT " OpDecorate %%%u", cur.index, target_id);
 
-            SpvDecoration decoration = (SpvDecoration)instr->words[2];
+                SpvDecoration decoration = (SpvDecoration)instr->words[2];
 
-            handle_spirv_decoration(instr->words + 3, instr->word_count - 3, decoration, output);
+                handle_spirv_decoration(trace, instr->words + 3, instr->word_count - 3, decoration, output);
 
-            printf("\n");
+                _trace(trace, "\n");
+            }
             continue;
         }
         case SpvOpMemberDecorate:
         {
-            assert(instr->word_count >= 4);
             ::add_at_end(&output->decorations, instr);
-            ::add_at_end(&member_decor_idxs, i);
+            ::add_at_end(&member_decorations, instr);
             
             SpvId target_type_id = (SpvId)instr->words[1];
             assert(target_type_id < bound);
 
-            spirv_id_instruction *target_instr = output->id_instructions.data + target_type_id;
-            ::insert_element(&target_instr->decoration_indices, (u32)output->decorations.size-1);
-
-            u32 member = instr->words[2];
+            if (spirv_trace_enabled(trace, spirv_trace_level_instructions))
+            {
+                u32 member = instr->words[2];
 
-            printf(INSTR_FMT " OpMemberDecorate %%%u %u", i, target_type_id, member);
+                _trace(trace, INSTR_FMT " OpMemberDecorate %%%u %u", cur.index, target_type_id, member);
 
-            SpvDecoration decoration = (SpvDecoration)instr->words[3];
+                SpvDecoration decoration = (SpvDecoration)instr->words[3];
 
-            handle_spirv_decoration(instr->words + 4, instr->word_count - 4, decoration, output);
+                handle_spirv_decoration(trace, instr->words + 4, instr->word_count - 4, decoration, output);
 
-            printf("\n");
+                _trace(trace, "\n");
+            }
             continue;
         }
         case SpvOpDecorateId:
         {
-            assert(instr->word_count >= 3);
             ::add_at_end(&output->decorations, instr);
             
             SpvId target_id = (SpvId)instr->words[1];
             assert(target_id < bound);
 
-            spirv_id_instruction *target_instr = output->id_instructions.data + target_id;
-            ::insert_element(&target_instr->decoration_indices, (u32)output->decorations.size-1);
-
-            printf(INSTR_FMT " OpDecorateId %%%u", i, target_id);
+            if (spirv_trace_enabled(trace, spirv_trace_level_instructions))
+            {
+                _trace(trace, INSTR_FMT " OpDecorateId %%%u", cur.index, target_id);
 
-            SpvDecoration decoration = (SpvDecoration)instr->words[2];
+                SpvDecoration decoration = (SpvDecoration)instr->words[2];
 
-            handle_spirv_decoration(instr->words + 3, instr->word_count - 3, decoration, output);
+                handle_spirv_decoration(trace, instr->words + 3, instr->word_count - 3, decoration, output);
 
-            printf("\n");
+                _trace(trace, "\n");
+            }
             continue;
         }
-        case SpvOpDecorationGroup:
-        case SpvOpGroupDecorate:
-        case SpvOpGroupMemberDecorate:
+        default:
+            // decoration groups are not supported
             continue;
         }
-
-        break;
     }
 
-    printf("\nTypes\n");
+    _build_decoration_index(output, bound);
+
+    _next_phase(&clock, spirv_parse_phase_types, cur.index, cursor_offset());
+
+    spirv_trace(trace, spirv_trace_level_sections, "\nTypes\n");
 
     // 9. Type declarations
-    for (; i < instruction_count; ++i)
+    for (; cur.valid; advance(&cur))
     {
-        instr = instructions.data + i;
+        if (in_section(spirv_section_any))
+            continue;
 
-        switch (instr->opcode)
-        {
-        case SpvOpTypeVoid:
-        case SpvOpTypeBool:
-        case SpvOpTypeInt:
-        case SpvOpTypeFloat:
-        case SpvOpTypeVector:
-        case SpvOpTypeMatrix:
-        case SpvOpTypeImage:
-        case SpvOpTypeSampler:
-        case SpvOpTypeSampledImage:
-        case SpvOpTypeArray:
-        case SpvOpTypeRuntimeArray:
-        case SpvOpTypeStruct:
-        case SpvOpTypeOpaque:
-        case SpvOpTypePointer:
-        case SpvOpTypeFunction:
-        case SpvOpTypeEvent:
-        case SpvOpTypeDeviceEvent:
-        case SpvOpTypeReserveId:
-        case SpvOpTypeQueue:
-        case SpvOpTypePipe:
-        case SpvOpTypePipeStorage:
-        case SpvOpTypeNamedBarrier:
+        if (op->section != spirv_section_types)
+            break;
+
+        if (op->flags & spirv_opcode_flag_type)
         {
-            assert(instr->word_count >= 2);
             SpvId id = (SpvId)instr->words[1];
-            assert(id < bound);
 
-            spirv_id_instruction *id_instr = output->id_instructions.data + id;
-
-            ::copy_memory(instr, id_instr, sizeof(spirv_instruction));
+            if (!_define_id(output, id, instr, validate, cur.index, err))
+                return false;
             spirv_type *t = ::add_at_end(&output->types);
             ::init(t);
-            t->instruction = id_instr;
-            t->size = UNCALCULATED;
-            id_instr->extra = output->types.size - 1; // index of the type in the types array...
+            t->id = id;
+            t->instruction = *instr;
+            output->ids.extras[id] = output->types.size - 1; // index of the type in the types array...
 
-            handle_spirv_op_type(i, t, output);
-            break;
-        }
+            if (instr->opcode == SpvOpTypeStruct)
+            {
+                SpvId *member_ids = (SpvId*)(instr->words + 2);
+                u32 member_count = instr->word_count - 2;
+
+                _reserve_exact(&t->members, member_count, output);
+                t->members.size = member_count;
+                ::fill_memory(t->members.data, 0, member_count);
+
+                for (u32 mem_i = 0; mem_i < member_count; ++mem_i)
+                    t->members[mem_i].type_id = member_ids[mem_i];
+            }
 
-        case SpvOpVariable:
-        case SpvOpConstant:
-        case SpvOpConstantNull:
-        case SpvOpConstantTrue:
-        case SpvOpConstantFalse:
-        case SpvOpConstantComposite:
-        case SpvOpConstantSampler:
-        case SpvOpSpecConstant:
-        case SpvOpSpecConstantOp:
-        case SpvOpSpecConstantTrue:
-        case SpvOpSpecConstantFalse:
-        case SpvOpSpecConstantComposite:
+            if (spirv_trace_enabled(trace, spirv_trace_level_instructions))
+                handle_spirv_op_type(trace, cur.index, t, output);
+        }
+        else if (op->flags & spirv_opcode_flag_value)
         {
-            assert(instr->word_count >= 3);
             // words[1] is result type
             SpvId id = (SpvId)instr->words[2];
-            assert(id < bound);
-
-            spirv_id_instruction *id_instr = output->id_instructions.data + id;
 
-            ::copy_memory(instr, id_instr, sizeof(spirv_instruction));
+            if (!_define_id(output, id, instr, validate, cur.index, err))
+                return false;
             spirv_variable *var = ::add_at_end(&output->variables);
-            var->instruction = id_instr;
-            id_instr->extra = output->variables.size - 1;
+            var->id = id;
+            var->instruction = *instr;
+            output->ids.extras[id] = output->variables.size - 1;
 
-            handle_spirv_op_variable(i, id_instr, output);
-            break;
+            if (spirv_trace_enabled(trace, spirv_trace_level_instructions))
+                handle_spirv_op_variable(trace, cur.index, var, output);
+        }
+        else if (op->result_id_word != 0)
+        {
+            // OpUndef, has an id but nothing to reflect
+            if (!_define_id(output, (SpvId)instr->words[op->result_id_word], instr, validate, cur.index, err))
+                return false;
         }
 
-        case SpvOpTypeForwardPointer:
-        case SpvOpLine:
-        case SpvOpNoLine:
-            continue;
-
-        default:
-            breakout = true;
-            break;
+        // OpTypeForwardPointer declares nothing new
+    }
+
+    if (validate)
+    {
+        for_array(i, t, &output->types)
+        if (!_validate_type_operands(&t->instruction, (u32)i, output))
+        {
+            get_spirv_parse_error(err, "operand of type %%%u is not a type", t->id);
+            return false;
         }
 
-        if (breakout)
+        for_array(var, &output->variables)
+        if (!_validate_type_operands(&var->instruction, max_value(u32), output))
         {
-            breakout = false;
-            break;
+            get_spirv_parse_error(err, "result type of %%%u is not a type", var->id);
+            return false;
         }
     }
 
+    // member fixups revisit instructions of earlier sections
+    u64 types_end_index = cur.index;
+    u64 types_end_offset = cursor_offset();
+    _next_phase(&clock, spirv_parse_phase_member_fixups, types_end_index, types_end_offset);
+
     // take care of member debug info
-    for_array(_mem_idx, &member_name_idxs)
+    for_array(minstr, &member_names)
     {
-        instr = instructions.data + *_mem_idx;
-
-        assert(instr->word_count >= 4);
-        SpvId id = (SpvId)instr->words[1];
+        assert(minstr->word_count >= 4);
+        SpvId id = (SpvId)minstr->words[1];
         assert(id < bound);
 
-        u32 member = instr->words[2];
-        const char *member_name = (const char *)(instr->words + 3);
+        u32 member = minstr->words[2];
+        const char *member_name = (const char *)(minstr->words + 3);
+
+        u32 type_index = output->ids.extras[id];
 
-        spirv_id_instruction *idinstr = output->id_instructions.data + id;
-        assert(idinstr->extra < output->types.size);
-        spirv_type *type = output->types.data + idinstr->extra;
+        if (type_index >= output->types.size || !_is_type_opcode(output->ids.opcodes[id]))
+        {
+            get_spirv_parse_error(err, "OpMemberName target %%%u is not a type", id);
+            return false;
+        }
 
-        if (member >= type->members.reserved_size)
-            ::reserve(&type->members, member + 4);
+        spirv_type *type = output->types.data + type_index;
 
+        // members are sized by OpTypeStruct, names of members that don't
+        // exist are ignored.
         if (member >= type->members.size)
-            type->members.size = member + 1;
+            continue;
 
         type->members[member].name = member_name;
-        type->members[member].offset = 0;
     }
 
     // take care of member decorations
-    for_array(_mem_dec_idx, &member_decor_idxs)
+    for_array(minstr, &member_decorations)
     {
-        instr = instructions.data + *_mem_dec_idx;
+        SpvId target_type_id = (SpvId)minstr->words[1];
 
-        SpvId target_type_id = (SpvId)instr->words[1];
+        u32 type_index = output->ids.extras[target_type_id];
 
-        spirv_id_instruction *idinstr = output->id_instructions.data + target_type_id;
-        spirv_type *type = output->types.data + idinstr->extra;
+        if (type_index >= output->types.size)
+            continue;
 
-        u32 member = instr->words[2];
+        spirv_type *type = output->types.data + type_index;
 
-        if (member >= type->members.reserved_size)
-            ::reserve(&type->members, member + 4);
+        u32 member = minstr->words[2];
 
         if (member >= type->members.size)
-            type->members.size = member + 1;
+            continue;
 
-        SpvDecoration decoration = (SpvDecoration)instr->words[3];
+        SpvDecoration decoration = (SpvDecoration)minstr->words[3];
 
         switch (decoration)
         {
         case SpvDecorationOffset:
         {
-            u32 offset = instr->words[4];
+            u32 offset = minstr->words[4];
             type->members[member].offset = offset;
+            type->members[member].explicit_offset = true;
+            break;
+        }
+        case SpvDecorationMatrixStride:
+        {
+            type->members[member].matrix_stride = minstr->words[4];
+            break;
+        }
+        case SpvDecorationRowMajor:
+        {
+            type->members[member].row_major = true;
             break;
         }
 
@@ -1583,139 +2808,170 @@ bool parse_spirv_from_memory(memory_stream *input, spirv_info *output, error *er
         }
     }
 
-    printf("\nFunctions\n");
+    if (clock.stats != nullptr)
+    {
+        spirv_parse_phase_stats *fixups = clock.stats->phases + spirv_parse_phase_member_fixups;
+        fixups->instructions = member_names.size + member_decorations.size;
+
+        for_array(minstr, &member_names)
+            fixups->bytes += minstr->word_count * sizeof(u32);
+
+        for_array(minstr, &member_decorations)
+            fixups->bytes += minstr->word_count * sizeof(u32);
+    }
+
+    _next_phase(&clock, spirv_parse_phase_functions, types_end_index, types_end_offset);
+
+    spirv_trace(trace, spirv_trace_level_sections, "\nFunctions\n");
 
     // 10. & 11. Functions
-    for (; i < instruction_count; ++i)
+    for (; cur.valid; advance(&cur))
     {
-        instr = instructions.data + i;
+        if (in_section(spirv_section_any))
+            continue;
 
-        assert(instr->opcode == SpvOpFunction);
-        assert(instr->word_count == 5);
+        if (instr->opcode != SpvOpFunction)
+        {
+            get_spirv_parse_error(err, INSTR_FMT " expected OpFunction, got opcode %u", cur.index, (u32)instr->opcode);
+            return false;
+        }
 
         SpvId result_type_id = (SpvId)instr->words[1];
         assert(result_type_id < bound);
 
         SpvId result_id = (SpvId)instr->words[2];
-        assert(result_id < bound);
 
-        spirv_id_instruction *id_instr = output->id_instructions.data + result_id;
-        ::copy_memory(instr, id_instr, sizeof(spirv_instruction));
+        if (!_define_id(output, result_id, instr, validate, cur.index, err))
+            return false;
 
         u32 func_index = (u32)output->functions.size;
         spirv_function *func = ::add_at_end(&output->functions);
         init(func);
-        func->instruction = id_instr;
-
-        for_array(ep, &output->entry_points)
-        if (id_instr == ep->instruction)
-        {
-            ep->function_index = func_index;
-            break;
-        }
+        func->id = result_id;
+        func->instruction = *instr;
+        output->ids.extras[result_id] = func_index;
 
         SpvFunctionControlMask control_mask = (SpvFunctionControlMask)instr->words[3];
 
         SpvId function_type_id = (SpvId)instr->words[4];
         assert(function_type_id < bound);
 
-        printf(INSTR_ID_FMT " OpFunction %%%u %d %%%u\n", i, result_id, result_type_id, control_mask, function_type_id);
+        spirv_trace(trace, spirv_trace_level_instructions, INSTR_ID_FMT " OpFunction %%%u %d %%%u\n", cur.index, result_id, result_type_id, control_mask, function_type_id);
 
-        ++i;
-        for (; i < instruction_count; ++i)
+        advance(&cur);
+        for (; cur.valid; advance(&cur))
         {
-            spirv_instruction *finstr = instructions.data + i;
+            spirv_instruction *finstr = instr;
+            op = get_spirv_opcode_info(finstr->opcode);
+            _check_instruction(finstr, op, bound);
 
             switch (finstr->opcode)
             {
             case SpvOpFunctionParameter:
             {
-                assert(finstr->word_count == 3);
-
                 SpvId result_type_id = (SpvId)finstr->words[1];
                 assert(result_type_id < bound);
 
                 SpvId result_id = (SpvId)finstr->words[2];
-                assert(result_id < bound);
 
-                printf(INSTR_ID_FMT " OpFunctionParameter %%%u\n", i, result_id, result_type_id);
+                spirv_trace(trace, spirv_trace_level_instructions, INSTR_ID_FMT " OpFunctionParameter %%%u\n", cur.index, result_id, result_type_id);
 
                 break;
             }
             case SpvOpLabel:
             {
-                printf(INSTR_FMT " OpLabel\n", i);
+                spirv_trace(trace, spirv_trace_level_instructions, INSTR_FMT " OpLabel\n", cur.index);
                 break;
             }
             case SpvOpAccessChain:
             {
-                assert(finstr->word_count >= 4);
-
                 SpvId result_type_id = (SpvId)finstr->words[1];
                 assert(result_type_id < bound);
 
                 SpvId result_id = (SpvId)finstr->words[2];
-                assert(result_id < bound);
 
                 SpvId base_id = (SpvId)finstr->words[3];
                 assert(base_id < bound);
 
-                printf(INSTR_ID_FMT " OpAccessChain %%%u %%%u", i, result_id, result_type_id, base_id);
+                if (!spirv_trace_enabled(trace, spirv_trace_level_instructions))
+                    break;
+
+                _trace(trace, INSTR_ID_FMT " OpAccessChain %%%u %%%u", cur.index, result_id, result_type_id, base_id);
 
                 for (u32 ac = 4; ac < finstr->word_count; ++ac)
                 {
                     SpvId index_id = (SpvId)finstr->words[ac];
                     assert(index_id < bound);
 
-                    printf(" %%%u", index_id);
+                    _trace(trace, " %%%u", index_id);
                 }
 
-                printf("\n");
+                _trace(trace, "\n");
 
                 break;
             }
             case SpvOpLoad:
             {
-                assert(finstr->word_count >= 4);
-
                 SpvId result_type_id = (SpvId)finstr->words[1];
                 assert(result_type_id < bound);
 
                 SpvId result_id = (SpvId)finstr->words[2];
-                assert(result_id < bound);
 
                 SpvId ptr_id = (SpvId)finstr->words[3];
                 assert(ptr_id < bound);
 
-                printf(INSTR_ID_FMT " OpLoad %%%u %%%u", i, result_id, result_type_id, ptr_id);
+                if (!spirv_trace_enabled(trace, spirv_trace_level_instructions))
+                    break;
+
+                _trace(trace, INSTR_ID_FMT " OpLoad %%%u %%%u", cur.index, result_id, result_type_id, ptr_id);
 
                 for (u32 load = 4; load < finstr->word_count; ++load)
                 {
                     SpvMemoryAccessMask msk = (SpvMemoryAccessMask)finstr->words[load];
 
-                    printf(" %d", msk);
+                    _trace(trace, " %d", msk);
                 }
 
-                printf("\n");
+                _trace(trace, "\n");
+
+                break;
+            }
+            case SpvOpFunctionCall:
+            {
+                SpvId result_type_id = (SpvId)finstr->words[1];
+                assert(result_type_id < bound);
+
+                SpvId result_id = (SpvId)finstr->words[2];
+
+                SpvId callee_id = (SpvId)finstr->words[3];
+                assert(callee_id < bound);
+
+                if (!spirv_trace_enabled(trace, spirv_trace_level_instructions))
+                    break;
+
+                _trace(trace, INSTR_ID_FMT " OpFunctionCall %%%u %%%u", cur.index, result_id, result_type_id, callee_id);
+
+                for (u32 arg = 4; arg < finstr->word_count; ++arg)
+                    _trace(trace, " %%%u", finstr->words[arg]);
+
+                _trace(trace, "\n");
 
                 break;
             }
             case SpvOpReturn:
             {
-                printf(INSTR_FMT " OpReturn\n", i);
+                spirv_trace(trace, spirv_trace_level_instructions, INSTR_FMT " OpReturn\n", cur.index);
                 break;
             }
             case SpvOpFunctionEnd:
             {
-                assert(finstr->word_count == 1);
-
-                printf(INSTR_FMT " OpFunctionEnd\n", i);
+                spirv_trace(trace, spirv_trace_level_instructions, INSTR_FMT " OpFunctionEnd\n", cur.index);
 
                 breakout = true;
                 break;
             }
 
-            // TODO: handle branches / other functions
+            // TODO: handle branches
 
             default:
                 break;
@@ -1729,6 +2985,17 @@ bool parse_spirv_from_memory(memory_stream *input, spirv_info *output, error *er
         }
     }
 
+    u64 end_index = cur.index;
+    u64 end_offset = cursor_offset();
+
+#undef in_section
+#undef cursor_offset
+
+    // the extra of a function id is its function index
+    for_array(ep, &output->entry_points)
+    if (output->ids.opcodes[ep->id] == SpvOpFunction)
+        ep->function_index = output->ids.extras[ep->id];
+
     for_array(ep, &output->entry_points)
     if (ep->function_index == max_value(u32))
     {
@@ -1736,31 +3003,75 @@ bool parse_spirv_from_memory(memory_stream *input, spirv_info *output, error *er
         return false;
     }
 
-    printf("\nExtra function information\n");
+    _next_phase(&clock, spirv_parse_phase_function_information, end_index, end_offset);
 
-    collect_function_information(output);
+    spirv_trace(trace, spirv_trace_level_sections, "\nExtra function information\n");
 
-    printf("\nExtra type information\n");
+    u64 scratch_bytes = _collect_function_information(output, trace);
 
-    collect_type_information(output);
+    _next_phase(&clock, spirv_parse_phase_type_layouts, end_index, end_offset);
 
-    // print_extra_type_information(output);
+    spirv_trace(trace, spirv_trace_level_sections, "\nExtra type information\n");
+
+    compute_type_layouts(output, options != nullptr ? options->layout_rules : spirv_layout_rules_std430);
+
+    if (clock.stats != nullptr)
+    {
+        spirv_parse_phase_stats *layouts = clock.stats->phases + spirv_parse_phase_type_layouts;
+        layouts->instructions = output->types.size;
+
+        for_array(t, &output->types)
+            layouts->bytes += t->instruction.word_count * sizeof(u32);
+    }
+
+    _next_phase(&clock, spirv_parse_phase_count, end_index, end_offset);
+
+    // the containers of the info only grow during the parse, so the most
+    // was held at the end of collecting function information, with its
+    // scratch and the member scratch arrays still alive.
+    spirv_info_memory_usage usage{};
+    get_memory_usage(output, &usage);
+    output->parse_peak_bytes = usage.total + scratch_bytes;
+
+    if (!output->use_arena)
+        output->parse_peak_bytes += _reserved_bytes(&member_names) + _reserved_bytes(&member_decorations);
+
+    // print_extra_type_information(trace, output);
 
     return true;
 }
 
-bool parse_spirv_from_file(const char *file, spirv_info *output, error *err)
+bool parse_spirv_from_file(const char *file, spirv_info *output, error *err, const spirv_parse_options *options)
 {
     assert(file != nullptr);
     assert(output != nullptr);
 
-    memory_stream *mem = &output->data;
-    ::init(mem);
+    ::init(&output->owned_data);
+    ::init(&output->mapping);
 
-    if (!::read_entire_file(file, mem, err))
-        return false;
+    memory_stream mem{};
+
+    if (options != nullptr && options->use_mmap)
+    {
+        if (!::map_file(&output->mapping, file, options->mmap_advice, err))
+            return false;
+
+        mem.data = (char*)output->mapping.data;
+        mem.size = output->mapping.size;
+        mem.position = 0;
+    }
+    else
+    {
+        if (!::read_entire_file(file, &output->owned_data, err))
+            return false;
+
+        mem = output->owned_data;
+        mem.position = 0;
+    }
 
-    if (!parse_spirv_from_memory(mem, output, err))
+    // the mapping or owned_data is released by free(spirv_info*), or when
+    // a byteswapped module is converted.
+    if (!parse_spirv_from_memory(&mem, output, err, options))
         return false;
 
     return true;
@@ -1774,8 +3085,8 @@ u64 get_indirect_type_size(SpvId type_id, spirv_info *info)
     if (t == nullptr)
         return 0;
 
-    if (t->instruction->opcode == SpvOpTypePointer)
-        return get_indirect_type_size((SpvId)t->instruction->words[3], info);
+    if (t->instruction.opcode == SpvOpTypePointer)
+        return get_indirect_type_size((SpvId)t->instruction.words[3], info);
 
     return t->size;
 }
@@ -1787,22 +3098,29 @@ VkDescriptorType get_descriptor_type_by_spirv_type(SpvId type_id, spirv_info *in
     if (t == nullptr)
         return (VkDescriptorType)max_value(int);
 
-    switch (t->instruction->opcode)
+    switch (t->instruction.opcode)
     {
     case SpvOpTypePointer:
     {
-        SpvStorageClass s = (SpvStorageClass)t->instruction->words[2];
-        SpvId rtype_id = (SpvId)t->instruction->words[3];
+        SpvStorageClass s = (SpvStorageClass)t->instruction.words[2];
+        SpvId rtype_id = (SpvId)t->instruction.words[3];
 
         return get_descriptor_type_by_spirv_type(rtype_id, info, s);
     }
+    case SpvOpTypeArray:
+    case SpvOpTypeRuntimeArray:
+    {
+        // arrays of descriptors have the type of their element
+        if (storage != SpvStorageClassUniform && storage != SpvStorageClassStorageBuffer)
+            return get_descriptor_type_by_spirv_type((SpvId)t->instruction.words[2], info, storage);
+
+        return storage == SpvStorageClassUniform ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    }
     case SpvOpTypeBool:
     case SpvOpTypeInt:
     case SpvOpTypeFloat:
     case SpvOpTypeVector:
     case SpvOpTypeMatrix:
-    case SpvOpTypeArray:
-    case SpvOpTypeRuntimeArray:
     case SpvOpTypeStruct:
     {
         switch (storage)
@@ -1823,14 +3141,54 @@ VkDescriptorType get_descriptor_type_by_spirv_type(SpvId type_id, spirv_info *in
     }
 }
 
+// number of descriptors of a variable of pointer type pointer_type_id,
+// the product of the lengths of its arrays. runtime arrays count as 1
+// and set runtime_array.
+static u32 _get_descriptor_count(SpvId pointer_type_id, spirv_info *info, bool *runtime_array)
+{
+    *runtime_array = false;
+
+    spirv_type *t = get_type_by_id(info, pointer_type_id);
+
+    if (t == nullptr || t->instruction.opcode != SpvOpTypePointer)
+        return 1;
+
+    t = get_type_by_id(info, (SpvId)t->instruction.words[3]);
+    u64 count = 1;
+
+    while (t != nullptr)
+    {
+        if (t->instruction.opcode == SpvOpTypeArray)
+        {
+            u32 length = _get_array_length(t, info);
+
+            // unknown length, e.g. from OpSpecConstantOp
+            if (length == 0)
+                length = 1;
+
+            count *= length;
+        }
+        else if (t->instruction.opcode == SpvOpTypeRuntimeArray)
+            *runtime_array = true;
+        else
+            break;
+
+        t = get_type_by_id(info, (SpvId)t->instruction.words[2]);
+    }
+
+    return count > max_value(u32) ? max_value(u32) : (u32)count;
+}
+
 void init(spirv_descriptor_set *dset)
 {
     ::init(&dset->layout_bindings);
+    ::init(&dset->binding_flags);
 }
 
 void free(spirv_descriptor_set *dset)
 {
     ::free(&dset->layout_bindings);
+    ::free(&dset->binding_flags);
 }
 
 void init(spirv_pipeline_info *info)
@@ -1853,8 +3211,141 @@ VkShaderStageFlags execution_model_to_shader_stage_flags(SpvExecutionModel model
     return (VkShaderStageFlags)(1 << (int)(model));
 }
 
-void get_pipeline_info(spirv_pipeline_info *out, spirv_info *info)
+struct _push_constant_usage
+{
+    u64 begin;
+    u64 end;
+    bool whole; // used other than through a constant member index
+};
+
+static void _use_push_constant_member(_push_constant_usage *usage, spirv_type *block, u32 member)
+{
+    if (block == nullptr || member >= block->members.size)
+    {
+        usage->whole = true;
+        return;
+    }
+
+    spirv_struct_type_member *mem = block->members.data + member;
+    u64 end = mem->offset + mem->size;
+
+    if (mem->offset < usage->begin)
+        usage->begin = mem->offset;
+
+    if (end > usage->end)
+        usage->end = end;
+}
+
+// walks the functions ep reaches and records which members of the push
+// constant block var they access. var is used as a whole when it is
+// loaded, passed to a function or indexed by anything but a constant.
+// visited has one element per function.
+static void _get_push_constant_usage(spirv_entry_point *ep, spirv_variable *var, spirv_info *info, array<u32> *queue, array<bool> *visited, _push_constant_usage *usage)
+{
+    spirv_type *block = get_type_by_id(info, (SpvId)var->instruction.words[1]);
+
+    if (block != nullptr && block->instruction.opcode == SpvOpTypePointer)
+        block = get_type_by_id(info, (SpvId)block->instruction.words[3]);
+
+    if (block != nullptr && block->instruction.opcode != SpvOpTypeStruct)
+        block = nullptr;
+
+    usage->begin = max_value(u64);
+    usage->end = 0;
+    usage->whole = block == nullptr;
+
+    ::fill_memory(visited->data, 0, visited->size);
+    ::clear(queue);
+    ::add_at_end(queue, ep->function_index);
+    visited->data[ep->function_index] = true;
+
+    for (u64 q = 0; q < queue->size && !usage->whole; ++q)
+    {
+        spirv_instruction instr = info->functions[queue->data[q]].instruction;
+
+        while (next_instruction(&info->data, &instr) && !usage->whole)
+        {
+            if (instr.opcode == SpvOpFunctionEnd)
+                break;
+
+            if ((instr.opcode == SpvOpAccessChain || instr.opcode == SpvOpInBoundsAccessChain)
+             && instr.word_count >= 4 && instr.words[3] == var->id)
+            {
+                spirv_instruction index = get_id_instruction(info, instr.word_count >= 5 ? (SpvId)instr.words[4] : 0);
+
+                if (index.opcode == SpvOpConstant && index.word_count >= 4)
+                    _use_push_constant_member(usage, block, index.words[3]);
+                else
+                    usage->whole = true;
+
+                continue;
+            }
+
+            if (instr.opcode == SpvOpFunctionCall && instr.word_count >= 4)
+            {
+                SpvId callee_id = (SpvId)instr.words[3];
+
+                if (callee_id < info->ids.opcodes.size && info->ids.opcodes[callee_id] == SpvOpFunction)
+                {
+                    u32 callee = info->ids.extras[callee_id];
+
+                    if (!visited->data[callee])
+                    {
+                        visited->data[callee] = true;
+                        ::add_at_end(queue, callee);
+                    }
+                }
+            }
+
+            // any other use, the words checked may also be literals, which
+            // only makes the range larger than needed
+            for (u32 w = 1; w < instr.word_count; ++w)
+            if (instr.words[w] == var->id)
+            {
+                usage->whole = true;
+                break;
+            }
+        }
+    }
+
+    if (!usage->whole)
+        return;
+
+    if (block == nullptr)
+    {
+        usage->begin = 0;
+        usage->end = get_indirect_type_size((SpvId)var->instruction.words[1], info);
+        return;
+    }
+
+    usage->begin = max_value(u64);
+    usage->end = 0;
+    usage->whole = false;
+
+    for (u32 m = 0; m < block->members.size; ++m)
+        _use_push_constant_member(usage, block, m);
+
+    usage->whole = true;
+}
+
+// adds the descriptor bindings and push constants used by the entry points
+// of info to out. bindings already in out are merged by OR-ing their
+// stage flags. returns false and sets err if a binding already in out has
+// a different descriptor type, the binding keeps its first type.
+static bool _add_pipeline_info(spirv_pipeline_info *out, spirv_info *info, const spirv_trace_sink *trace, error *err)
 {
+    bool ok = true;
+
+    // for _get_push_constant_usage
+    array<u32> queue{};
+    array<bool> visited{};
+
+    defer
+    {
+        ::free(&queue);
+        ::free(&visited);
+    };
+
     for_array(ep, &info->entry_points)
     {
         spirv_function *func = info->functions.data + ep->function_index;
@@ -1862,25 +3353,43 @@ void get_pipeline_info(spirv_pipeline_info *out, spirv_info *info)
 
         for_array(_var, &func->referenced_variables)
         {
-            spirv_id_instruction *var_instr = (*_var)->instruction;
+            spirv_variable *var = *_var;
+            spirv_instruction *var_instr = &var->instruction;
             SpvId result_type_id = (SpvId)var_instr->words[1];
 
             if (var_instr->opcode == SpvOpVariable
              && ((SpvStorageClass)var_instr->words[3] == SpvStorageClassPushConstant))
             {
+                if (visited.size == 0)
+                    ::resize(&visited, info->functions.size);
+
+                _push_constant_usage usage;
+                _get_push_constant_usage(ep, var, info, &queue, &visited, &usage);
+
+                spirv_trace(trace, spirv_trace_level_verbose, "entry point %s uses push constants %%%u bytes %lu to %lu%s\n",
+                            ep->name, var->id, usage.begin, usage.end, usage.whole ? " (whole block)" : "");
+
+                // an entry point may declare push constants it never accesses
+                if (usage.end <= usage.begin)
+                    continue;
+
+                // offset and size of ranges are multiples of 4
                 VkPushConstantRange *range = ::add_at_end(&out->push_constants);
                 range->stageFlags = stage_flags;
-                range->offset = 0; // TODO: find out the offset???
-                range->size = get_indirect_type_size(result_type_id, info);
+                range->offset = (u32)(usage.begin & ~(u64)3);
+                range->size = (u32)(align_up(usage.end, 4) - range->offset);
                 continue;
             }
 
             u32 dset = max_value(u32);
             u32 binding = max_value(u32);
 
-            for_array(idx, &var_instr->decoration_indices)
+            u32 decoration_count = 0;
+            u32 *decoration_indices = get_decoration_indices(info, var->id, &decoration_count);
+
+            for (u32 d = 0; d < decoration_count; ++d)
             {
-                spirv_instruction *decor_instr = info->decorations.data + (*idx);
+                spirv_instruction *decor_instr = info->decorations.data + decoration_indices[d];
 
                 if (decor_instr->opcode != SpvOpDecorate)
                     continue;
@@ -1907,7 +3416,7 @@ void get_pipeline_info(spirv_pipeline_info *out, spirv_info *info)
                     break;
             }
 
-            printf("%u %u\n", dset, binding);
+            spirv_trace(trace, spirv_trace_level_verbose, "dset %u binding %u\n", dset, binding);
 
             if (dset == max_value(u32) || binding == max_value(u32))
                 continue;
@@ -1927,20 +3436,208 @@ void get_pipeline_info(spirv_pipeline_info *out, spirv_info *info)
             if (binding >= sds->layout_bindings.size)
             {
                 ::reserve(&sds->layout_bindings, binding + 4);
+                ::reserve(&sds->binding_flags, binding + 4);
 
                 u64 cursize = sds->layout_bindings.size;
                 u64 diff = (binding + 1) - cursize;
                 ::fill_memory(sds->layout_bindings.data + cursize, 0, diff);
+                ::fill_memory(sds->binding_flags.data + cursize, 0, diff);
 
                 sds->layout_bindings.size = binding + 1;
+                sds->binding_flags.size = binding + 1;
             }
 
             VkDescriptorSetLayoutBinding *lb = sds->layout_bindings.data + binding;
+            VkDescriptorType type = get_descriptor_type_by_spirv_type(result_type_id, info);
+
+            bool runtime_array = false;
+            u32 count = _get_descriptor_count(result_type_id, info, &runtime_array);
+
+            // unused bindings in between are zeroed, used ones have a count
+            if (lb->descriptorCount != 0 && lb->descriptorType != type)
+            {
+                spirv_trace(trace, spirv_trace_level_verbose, "conflict: dset %u binding %u is type %d and %d\n", dset, binding, lb->descriptorType, type);
+
+                if (ok)
+                    get_spirv_parse_error(err, "descriptor set %u binding %u is used with descriptor types %d and %d", dset, binding, lb->descriptorType, type);
+
+                ok = false;
+                lb->stageFlags |= stage_flags;
+                continue;
+            }
+
+            if (runtime_array)
+                sds->binding_flags[binding] |= VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT
+                                             | VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT;
+
             lb->binding = binding;
-            lb->descriptorCount = 1; // TODO: implement descriptor count
+            lb->descriptorCount = count > lb->descriptorCount ? count : lb->descriptorCount;
             lb->stageFlags |= stage_flags;
             lb->pImmutableSamplers = nullptr;
-            lb->descriptorType = get_descriptor_type_by_spirv_type(result_type_id, info);
+            lb->descriptorType = type;
+        }
+    }
+
+    return ok;
+}
+
+// only the highest binding of a set may have a variable descriptor count,
+// runtime arrays below it stay partially bound.
+static void _fix_variable_descriptor_counts(spirv_pipeline_info *out)
+{
+    for_array(dset, &out->descriptor_sets)
+    {
+        u64 highest = dset->layout_bindings.size;
+
+        for (u64 i = dset->layout_bindings.size; i > 0; --i)
+        if (dset->layout_bindings[i - 1].descriptorCount != 0)
+        {
+            highest = i - 1;
+            break;
+        }
+
+        for_array(i, flags, &dset->binding_flags)
+        if (i != highest)
+            *flags &= ~(VkDescriptorBindingFlags)VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT;
+    }
+}
+
+// every stage may only be in one push constant range: the ranges of each
+// stage are combined into one covering range, then identical ranges of
+// different stages are combined into one range with both stages.
+// ranges of different stages are not widened to merge them, that would
+// make vkCmdPushConstants require more stages for the same bytes.
+// the result is sorted by offset.
+static void _merge_push_constant_ranges(spirv_pipeline_info *out)
+{
+    array<VkPushConstantRange> *ranges = &out->push_constants;
+    u64 count = 0;
+
+    for_array(pc, ranges)
+    {
+        VkPushConstantRange *same_stage = nullptr;
+
+        for (u64 i = 0; i < count; ++i)
+        if (ranges->data[i].stageFlags == pc->stageFlags)
+        {
+            same_stage = ranges->data + i;
+            break;
+        }
+
+        if (same_stage == nullptr)
+        {
+            ranges->data[count++] = *pc;
+            continue;
+        }
+
+        u32 end = same_stage->offset + same_stage->size;
+        u32 pc_end = pc->offset + pc->size;
+
+        if (pc->offset < same_stage->offset)
+            same_stage->offset = pc->offset;
+
+        same_stage->size = (end > pc_end ? end : pc_end) - same_stage->offset;
+    }
+
+    ranges->size = count;
+    count = 0;
+
+    for_array(pc, ranges)
+    {
+        bool merged = false;
+
+        for (u64 i = 0; i < count; ++i)
+        {
+            VkPushConstantRange *other = ranges->data + i;
+
+            if (other->offset == pc->offset && other->size == pc->size)
+            {
+                other->stageFlags |= pc->stageFlags;
+                merged = true;
+                break;
+            }
+        }
+
+        if (!merged)
+            ranges->data[count++] = *pc;
+    }
+
+    ranges->size = count;
+
+    for (u64 i = 1; i < ranges->size; ++i)
+    {
+        VkPushConstantRange pc = ranges->data[i];
+        u64 j = i;
+
+        for (; j > 0; --j)
+        {
+            VkPushConstantRange *prev = ranges->data + j - 1;
+
+            if (prev->offset < pc.offset || (prev->offset == pc.offset && prev->size <= pc.size))
+                break;
+
+            ranges->data[j] = *prev;
         }
+
+        ranges->data[j] = pc;
+    }
+}
+
+u32 get_push_constants_size(const spirv_pipeline_info *info)
+{
+    assert(info != nullptr);
+
+    u32 size = 0;
+
+    for_array(pc, &info->push_constants)
+    if (pc->offset + pc->size > size)
+        size = pc->offset + pc->size;
+
+    return size;
+}
+
+u64 get_memory_usage(const spirv_pipeline_info *info)
+{
+    assert(info != nullptr);
+
+    u64 bytes = _reserved_bytes(&info->descriptor_sets) + _reserved_bytes(&info->push_constants);
+
+    for_array(dset, &info->descriptor_sets)
+        bytes += _reserved_bytes(&dset->layout_bindings) + _reserved_bytes(&dset->binding_flags);
+
+    return bytes;
+}
+
+void get_pipeline_info(spirv_pipeline_info *out, spirv_info *info, const spirv_trace_sink *trace)
+{
+    if (trace == nullptr)
+        trace = &_null_trace_sink;
+
+    // conflicts within one module are traced, the first type is kept
+    _add_pipeline_info(out, info, trace, nullptr);
+    _fix_variable_descriptor_counts(out);
+    _merge_push_constant_ranges(out);
+}
+
+bool get_pipeline_info(spirv_pipeline_info *out, spirv_info **infos, u64 info_count, error *err, const spirv_trace_sink *trace)
+{
+    assert(out != nullptr);
+    assert(infos != nullptr || info_count == 0);
+
+    if (trace == nullptr)
+        trace = &_null_trace_sink;
+
+    bool ok = true;
+
+    for (u64 i = 0; i < info_count; ++i)
+    {
+        // only the first conflict is reported
+        if (!_add_pipeline_info(out, infos[i], trace, ok ? err : nullptr))
+            ok = false;
     }
+
+    _fix_variable_descriptor_counts(out);
+    _merge_push_constant_ranges(out);
+
+    return ok;
 }
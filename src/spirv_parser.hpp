@@ -1,7 +1,12 @@
+#pragma once
 
+#include <stdio.h>
+#include <stdarg.h>
 #include <vulkan/vulkan_core.h>
 
 #include "spirv1_2.h"
+#include "spirv_arena.hpp"
+#include "spirv_mmap.hpp"
 
 #include "shl/array.hpp"
 #include "shl/set.hpp"
@@ -9,7 +14,7 @@
 #include "shl/streams.hpp"
 
 struct spirv_instruction;
-struct spirv_id_instruction;
+struct spirv_id_table;
 struct spirv_function;
 struct spirv_entry_point_execution_mode;
 struct spirv_entry_point;
@@ -26,22 +31,26 @@ struct spirv_instruction
     u32 extra; // meaning changes depending on opcode
 };
 
-struct spirv_id_instruction : public spirv_instruction
+// the id table in structure-of-arrays form. every column has bound
+// elements and is indexed by id, so lookups only touch the columns
+// they need.
+struct spirv_id_table
 {
-    SpvId id;
-    const char *name;
-
-    set<u32> decoration_indices; // indices into spirv_info->decorations
+    array<u16> opcodes; // SpvOpNop if no instruction was recorded for the id
+    array<u16> word_counts;
+    array<u32> word_offsets; // offset of the instruction in words from spirv_info::data
+    array<u32> extras; // meaning changes depending on opcode, e.g. index into spirv_info::types
+    array<const char*> names; // from OpName, may be nullptr
 };
 
-void init(spirv_id_instruction *instr);
-void free(spirv_id_instruction *instr);
+#define spirv_id_table_bytes_per_id (2 * sizeof(u16) + 2 * sizeof(u32) + sizeof(const char*))
 
 struct spirv_function
 {
-    spirv_id_instruction *instruction;
+    SpvId id;
+    spirv_instruction instruction;
 
-    array<u32> called_function_indices; // index into spirv_info->functions
+    array<u32> called_function_indices; // index into spirv_info->functions, empty since SPIR-V 1.4
     set<spirv_variable*> referenced_variables;
 };
 
@@ -57,12 +66,14 @@ struct spirv_entry_point_execution_mode
 
 struct spirv_entry_point
 {
-    spirv_id_instruction *instruction;
+    SpvId id; // id of the entry point function
     u32 function_index; // index into spirv_info->functions
     SpvExecutionModel execution_model; // i.e. the stage
     const char *name; // name in OpEntryPoint, probably same as in OpName
 
-    SpvId *refs; 
+    // the interface of the entry point. before SPIR-V 1.4 only Input and
+    // Output variables, since 1.4 every global variable the entry point uses.
+    SpvId *refs;
     u16 ref_count;
 
     array<spirv_entry_point_execution_mode> execution_modes;
@@ -77,12 +88,35 @@ struct spirv_struct_type_member
     const char *name;
 
     u64 offset;
+    bool explicit_offset; // offset is from an Offset decoration
+    bool row_major; // RowMajor decoration, matrices only
+    u32 matrix_stride; // MatrixStride decoration, 0 if not decorated
+
+    // layout of the member within the struct, see compute_type_layouts.
+    // differs from the layout of its type for matrices with their own
+    // stride or major-ness.
+    u64 size;
+    u32 alignment;
+};
+
+// rules used for types without explicit layout decorations.
+// Offset, ArrayStride and MatrixStride decorations always take precedence.
+enum spirv_layout_rules : u8
+{
+    spirv_layout_rules_std140,
+    spirv_layout_rules_std430,
+    spirv_layout_rules_scalar
 };
 
 struct spirv_type
 {
-    spirv_id_instruction *instruction;
-    u64 size;
+    SpvId id;
+    spirv_instruction instruction;
+
+    // layout, see compute_type_layouts
+    u64 size; // including padding at the end of structs
+    u32 alignment;
+    u32 stride; // ArrayStride of arrays, column stride of (column major) matrices
 
     array<spirv_struct_type_member> members;
 };
@@ -92,41 +126,242 @@ void free(spirv_type *type);
 
 struct spirv_variable
 {
-    spirv_id_instruction *instruction;
+    SpvId id;
+    spirv_instruction instruction;
 };
 
 struct spirv_info
 {
-    array<spirv_id_instruction> id_instructions;
+    spirv_id_table ids;
     array<spirv_entry_point> entry_points;
     array<spirv_type> types;
     array<spirv_variable> variables; // and constants
     array<spirv_instruction> decorations;
 
+    // decorations per id in compressed sparse row form, the decorations
+    // of id are decoration_indices[decoration_offsets[id]] up to
+    // decoration_indices[decoration_offsets[id + 1]].
+    // decoration_offsets has bound + 1 entries.
+    array<u32> decoration_offsets;
+    array<u32> decoration_indices; // indices into decorations
+
     array<spirv_function> functions;
 
+    u32 version; // from the header, e.g. 0x00010400 for 1.4
     SpvAddressingModel addressing_model;
     SpvMemoryModel memory_model;
+    spirv_layout_rules layout_rules; // used for the type layouts
 
+    // the module in native endianness, instructions and names point into
+    // it. the input of parse_spirv_from_memory is borrowed, free(info)
+    // only releases owned_data, mapping and the arena.
     memory_stream data;
+
+    // heap memory of the module owned by the info: the file read by
+    // parse_spirv_from_file, or the converted copy of a byteswapped
+    // module without use_arena.
+    memory_stream owned_data;
+
+    // set if data was mapped by parse_spirv_from_file, in which case
+    // data.data is the mapping and free(info) unmaps it.
+    spirv_file_mapping mapping;
+
+    // set if the module was stored in the opposite endianness, data then
+    // holds a copy converted to native endianness, see
+    // parse_spirv_from_memory. the copy is in the arena if data_in_arena
+    // is set and in owned_data otherwise.
+    bool byteswapped;
+    bool data_in_arena;
+
+    // if use_arena is set, all containers above draw their memory from
+    // the arena and free(info) releases it at once.
+    // arena.block_count is the number of heap allocations the parse made
+    // for the info.
+    bool use_arena;
+    spirv_arena arena;
+
+    // the most bytes the parse held at once, see get_memory_usage
+    u64 parse_peak_bytes;
 };
 
 void init(spirv_info *info);
 void free(spirv_info *info);
 
+// live bytes of a spirv_info by component, from the reserved sizes of its
+// containers. allocator overhead and the spirv_info itself are not
+// counted.
+struct spirv_info_memory_usage
+{
+    u64 id_table; // bound-sized columns
+    u64 decorations; // including the per-id decoration index
+    u64 entry_points; // including execution modes
+    u64 types; // including struct members
+    u64 variables;
+    u64 functions; // including called functions and referenced variables
+    u64 data; // the module, if the info owns it on the heap or in the arena, 0 if borrowed
+
+    // with use_arena the containers above live in the arena, this is what
+    // its blocks hold beyond them: parse scratch, padding and unused space.
+    u64 arena_overhead;
+
+    u64 total; // heap bytes, the sum of the above
+    u64 mapped; // size of the file mapping with use_mmap, not part of total
+    u64 parse_peak; // spirv_info::parse_peak_bytes
+};
+
+void get_memory_usage(const spirv_info *info, spirv_info_memory_usage *out);
+
 spirv_entry_point *get_entry_point_by_id(spirv_info *info, SpvId id);
+// the type declared with id, nullptr if id is not a type.
+spirv_type *get_type_by_id(spirv_info *info, SpvId id);
+
+// the instruction recorded for id, opcode is SpvOpNop if there is none.
+spirv_instruction get_id_instruction(const spirv_info *info, SpvId id);
+const char *get_id_name(const spirv_info *info, SpvId id);
+
+// returns the indices into info->decorations of all decorations of id
+// and stores their number in count.
+u32 *get_decoration_indices(spirv_info *info, SpvId id, u32 *count);
+
+// tracing
+// define SPIRV_PARSER_TRACE as 0 to compile out all trace calls.
+#ifndef SPIRV_PARSER_TRACE
+#define SPIRV_PARSER_TRACE 1
+#endif
+
+enum spirv_trace_level : u8
+{
+    spirv_trace_level_none = 0,
+    spirv_trace_level_sections,     // header and section banners
+    spirv_trace_level_instructions, // every instruction, disassembly-style
+    spirv_trace_level_verbose       // analysis results, e.g. referenced variables
+};
+
+// receives already filtered messages, format is printf-style.
+typedef void (*spirv_trace_function)(void *context, const char *format, va_list args);
+
+struct spirv_trace_sink
+{
+    spirv_trace_function trace;
+    void *context;
+    spirv_trace_level level; // messages above this level are never formatted
+};
 
-bool parse_spirv_from_memory(memory_stream *input, spirv_info *output, error *err);
-bool parse_spirv_from_file(const char *file, spirv_info *output, error *err);
+// discards everything, this is the default.
+spirv_trace_sink spirv_null_trace_sink();
+// the disassembly-style output, written to file (e.g. stdout).
+spirv_trace_sink spirv_disassembly_trace_sink(FILE *file, spirv_trace_level level = spirv_trace_level_verbose);
 
+// parse statistics
+// the phases parse_spirv_from_memory goes through, in order.
+enum spirv_parse_phase : u8
+{
+    spirv_parse_phase_header = 0,           // header, byte swap, sizing pass and allocation
+    spirv_parse_phase_mode_setting,         // capabilities up to execution modes
+    spirv_parse_phase_debug,                // strings, sources and names
+    spirv_parse_phase_decorations,          // decorations and the per-id decoration index
+    spirv_parse_phase_types,                // types, constants and global variables
+    spirv_parse_phase_member_fixups,        // member names and member decorations
+    spirv_parse_phase_functions,
+    spirv_parse_phase_function_information, // collect_function_information
+    spirv_parse_phase_type_layouts,         // compute_type_layouts
+    spirv_parse_phase_count
+};
+
+const char *spirv_parse_phase_name(spirv_parse_phase phase);
+
+struct spirv_parse_phase_stats
+{
+    u64 ns; // wall time
+    u64 instructions; // instructions looked at, types for the layouts
+    u64 bytes; // bytes of those instructions, the whole module for the sizing pass
+    u64 allocations; // containers allocated by the parse, from the heap or the arena
+    u64 allocated_bytes;
+};
+
+struct spirv_parse_stats
+{
+    spirv_parse_phase_stats phases[spirv_parse_phase_count];
+    u64 total_ns;
+};
+
+struct spirv_parse_options
+{
+    spirv_trace_sink trace;
+
+    // allocate the whole spirv_info from one arena instead of many
+    // small heap allocations. arena_block_size is the minimum block size.
+    bool use_arena;
+    u64 arena_block_size;
+
+    // parse_spirv_from_file only: map the file instead of reading it into
+    // a heap buffer. instructions and names then point into the mapping,
+    // which stays alive until free(spirv_info*).
+    // mmap_advice is a combination of spirv_mmap_advice flags.
+    bool use_mmap;
+    u8 mmap_advice;
+
+    // layout rules for types without explicit layout, default std430
+    spirv_layout_rules layout_rules;
+
+    // check the module instead of relying on asserts: every word count,
+    // id and string operand is checked against the stream and the bound
+    // and errors are returned through err. without it, malformed modules
+    // are only caught by asserts, which release builds compile out.
+    bool validate;
+
+    // if not nullptr, cleared and filled with per-phase statistics during
+    // the parse. measuring costs a clock read per phase.
+    spirv_parse_stats *stats;
+};
+
+// universal limit of the id bound of a module, checked by the validating parse
+#define SPIRV_MAX_BOUND 4194303u
+
+void init(spirv_parse_options *options);
+
+// options may be nullptr, in which case defaults are used.
+// input is borrowed, whatever its endianness: output points into it and
+// must not outlive it, and free(output) does not close it.
+// modules of the opposite endianness are accepted and converted before
+// parsing into a copy in the arena, or the heap without use_arena, which
+// output owns. input is never written to, so the same buffer may be
+// parsed by several threads at once.
+// parse_spirv_from_file reads or maps the file into memory output owns.
+bool parse_spirv_from_memory(memory_stream *input, spirv_info *output, error *err, const spirv_parse_options *options = nullptr);
+bool parse_spirv_from_file(const char *file, spirv_info *output, error *err, const spirv_parse_options *options = nullptr);
+
+
+// (re)computes size, alignment and stride of every type with the given
+// rules. types are declared before they are used, so walking them in
+// declaration order computes every type exactly once without recursion.
+// called by the parser with spirv_parse_options::layout_rules.
+void compute_type_layouts(spirv_info *info, spirv_layout_rules rules);
+
+// fills called_function_indices and referenced_variables (transitively)
+// of every function reachable from an entry point. called by the parser,
+// the results of a previous call must be freed before calling it again.
+// since SPIR-V 1.4 the variables come from the entry point interfaces
+// instead: only the entry point functions get referenced_variables, and
+// called_function_indices stays empty for every function.
+void collect_function_information(spirv_info *info, const spirv_trace_sink *trace = nullptr);
 
 // utility functions
 // indirect type size resolves pointers
 u64 get_indirect_type_size(SpvId type_id, spirv_info *info);
 
+// layout_bindings is indexed by binding number, unused bindings have a
+// descriptorCount of 0. arrays of descriptors have the product of their
+// lengths as count, spec constant lengths their default value.
+// runtime arrays have a count of 1, the engine chooses the upper bound.
 struct spirv_descriptor_set
 {
     array<VkDescriptorSetLayoutBinding> layout_bindings;
+
+    // per binding, for VkDescriptorSetLayoutBindingFlagsCreateInfo.
+    // runtime arrays are PARTIALLY_BOUND, the one at the highest binding
+    // of the set is also VARIABLE_DESCRIPTOR_COUNT.
+    array<VkDescriptorBindingFlags> binding_flags;
 };
 
 void init(spirv_descriptor_set *dset);
@@ -141,6 +376,28 @@ struct spirv_pipeline_info
 void init(spirv_pipeline_info *info);
 void free(spirv_pipeline_info *info);
 
+// live heap bytes of the descriptor sets and push constant ranges
+u64 get_memory_usage(const spirv_pipeline_info *info);
+
+// maxPushConstantsSize every implementation supports
+#define SPIRV_GUARANTEED_PUSH_CONSTANTS_SIZE 128
+
+// the end of the last push constant range, pipelines above
+// SPIRV_GUARANTEED_PUSH_CONSTANTS_SIZE do not run everywhere.
+u32 get_push_constants_size(const spirv_pipeline_info *info);
+
 VkShaderStageFlags execution_model_to_shader_stage_flags(SpvExecutionModel model);
 
-void get_pipeline_info(spirv_pipeline_info *out, spirv_info *info);
+// push constant ranges only cover the members of the block each entry
+// point accesses, by their Offset decorations. a block that is used other
+// than through a constant member index, e.g. loaded as a whole, is
+// covered completely.
+void get_pipeline_info(spirv_pipeline_info *out, spirv_info *info, const spirv_trace_sink *trace = nullptr);
+
+// merges the pipeline info of several modules, e.g. the vertex and fragment
+// shader of a graphics pipeline, into out. stage flags of bindings used in
+// several modules are OR-ed, push constant ranges are merged.
+// returns false and sets err if a set / binding is used with different
+// descriptor types, in which case out is still filled but keeps the
+// first type of conflicting bindings.
+bool get_pipeline_info(spirv_pipeline_info *out, spirv_info **infos, u64 info_count, error *err, const spirv_trace_sink *trace = nullptr);
@@ -0,0 +1,106 @@
+
+#include <assert.h>
+
+#include "spirv_swap.hpp"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define SPIRV_BYTESWAP_X86 1
+#include <immintrin.h>
+#else
+#define SPIRV_BYTESWAP_X86 0
+#endif
+
+static void _byteswap_scalar(u32 *dst, const u32 *src, u64 count)
+{
+    for (u64 i = 0; i < count; ++i)
+        dst[i] = __builtin_bswap32(src[i]);
+}
+
+#if SPIRV_BYTESWAP_X86
+// every word of every 16 byte lane has its bytes reversed
+__attribute__((target("ssse3")))
+static void _byteswap_ssse3(u32 *dst, const u32 *src, u64 count)
+{
+    const __m128i mask = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+
+    u64 i = 0;
+
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_shuffle_epi8(v, mask));
+    }
+
+    _byteswap_scalar(dst + i, src + i, count - i);
+}
+
+__attribute__((target("avx2")))
+static void _byteswap_avx2(u32 *dst, const u32 *src, u64 count)
+{
+    const __m256i mask = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                          3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+
+    u64 i = 0;
+
+    // two vectors per iteration so loads and shuffles overlap
+    for (; i + 16 <= count; i += 16)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(src + i + 8));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_shuffle_epi8(a, mask));
+        _mm256_storeu_si256((__m256i*)(dst + i + 8), _mm256_shuffle_epi8(b, mask));
+    }
+
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(src + i));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_shuffle_epi8(a, mask));
+    }
+
+    _byteswap_scalar(dst + i, src + i, count - i);
+}
+#endif
+
+spirv_byteswap_isa get_best_byteswap_isa()
+{
+#if SPIRV_BYTESWAP_X86
+    if (__builtin_cpu_supports("avx2"))
+        return spirv_byteswap_isa_avx2;
+
+    if (__builtin_cpu_supports("ssse3"))
+        return spirv_byteswap_isa_ssse3;
+#endif
+
+    return spirv_byteswap_isa_scalar;
+}
+
+const char *byteswap_isa_name(spirv_byteswap_isa isa)
+{
+    switch (isa)
+    {
+    case spirv_byteswap_isa_scalar: return "scalar";
+    case spirv_byteswap_isa_ssse3:  return "ssse3";
+    case spirv_byteswap_isa_avx2:   return "avx2";
+    }
+
+    return "unknown";
+}
+
+void byteswap_words(u32 *dst, const u32 *src, u64 count, spirv_byteswap_isa isa)
+{
+    assert(dst == src || dst + count <= src || src + count <= dst);
+
+    switch (isa)
+    {
+#if SPIRV_BYTESWAP_X86
+    case spirv_byteswap_isa_avx2:  _byteswap_avx2(dst, src, count); return;
+    case spirv_byteswap_isa_ssse3: _byteswap_ssse3(dst, src, count); return;
+#endif
+    default:                       _byteswap_scalar(dst, src, count); return;
+    }
+}
+
+void byteswap_words(u32 *dst, const u32 *src, u64 count)
+{
+    byteswap_words(dst, src, count, get_best_byteswap_isa());
+}
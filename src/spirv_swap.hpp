@@ -0,0 +1,25 @@
+#pragma once
+
+#include "shl/number_types.hpp"
+
+// SPIR-V modules may be stored in either endianness, a module written on
+// a machine of the opposite endianness starts with the magic number with
+// its bytes reversed. the parser converts such modules once before parsing.
+#define SPIRV_SWAPPED_MAGIC_NUMBER 0x03022307u
+
+enum spirv_byteswap_isa : u8
+{
+    spirv_byteswap_isa_scalar,
+    spirv_byteswap_isa_ssse3, // one 16 byte shuffle per 4 words
+    spirv_byteswap_isa_avx2   // one 32 byte shuffle per 8 words
+};
+
+// the best isa the running cpu supports
+spirv_byteswap_isa get_best_byteswap_isa();
+const char *byteswap_isa_name(spirv_byteswap_isa isa);
+
+// reverses the bytes of count words of src and writes them to dst.
+// dst may be src to swap in place, otherwise they must not overlap.
+// isa must be supported by the cpu.
+void byteswap_words(u32 *dst, const u32 *src, u64 count, spirv_byteswap_isa isa);
+void byteswap_words(u32 *dst, const u32 *src, u64 count);
@@ -0,0 +1,125 @@
+
+#include <assert.h>
+
+#include "shl/memory.hpp"
+#include "spirv_update_template.hpp"
+
+#define align_up(X, A) ((((X) + (A) - 1) / (A)) * (A))
+
+void init(spirv_update_template *tmpl)
+{
+    assert(tmpl != nullptr);
+
+    ::init(&tmpl->entries);
+    tmpl->data_size = 0;
+    tmpl->data_alignment = 1;
+}
+
+void free(spirv_update_template *tmpl)
+{
+    if (tmpl == nullptr)
+        return;
+
+    ::free(&tmpl->entries);
+}
+
+// size and alignment of the host-side data of one descriptor
+static bool _descriptor_update_layout(VkDescriptorType type, u32 *size, u32 *alignment)
+{
+#define LAYOUT_OF(T)\
+    *size = sizeof(T); *alignment = alignof(T); return true;
+
+    switch (type)
+    {
+    case VK_DESCRIPTOR_TYPE_SAMPLER:
+    case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+    case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+    case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+    case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+        LAYOUT_OF(VkDescriptorImageInfo);
+
+    case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+    case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+    case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+    case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+        LAYOUT_OF(VkDescriptorBufferInfo);
+
+    // VkAccelerationStructureKHR is a non-dispatchable handle like VkBufferView
+    case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+    case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+    case VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR:
+        LAYOUT_OF(VkBufferView);
+
+    default:
+        *size = 0;
+        *alignment = 1;
+        return false;
+    }
+
+#undef LAYOUT_OF
+}
+
+u32 get_descriptor_update_size(VkDescriptorType type)
+{
+    u32 size;
+    u32 alignment;
+    _descriptor_update_layout(type, &size, &alignment);
+
+    return size;
+}
+
+void get_update_template(const spirv_descriptor_set *dset, spirv_update_template *out, u32 variable_descriptor_count)
+{
+    assert(dset != nullptr);
+    assert(out != nullptr);
+
+    ::clear(&out->entries);
+    out->data_size = 0;
+    out->data_alignment = 1;
+
+    u64 offset = 0;
+
+    for_array(i, lb, &dset->layout_bindings)
+    {
+        u32 size;
+        u32 alignment;
+
+        if (lb->descriptorCount == 0 || !_descriptor_update_layout(lb->descriptorType, &size, &alignment))
+            continue;
+
+        u32 count = lb->descriptorCount;
+
+        if (variable_descriptor_count != 0
+         && i < dset->binding_flags.size
+         && (dset->binding_flags[i] & VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT))
+            count = variable_descriptor_count;
+
+        offset = align_up(offset, alignment);
+
+        if (alignment > out->data_alignment)
+            out->data_alignment = alignment;
+
+        VkDescriptorUpdateTemplateEntry *entry = ::add_at_end(&out->entries);
+        entry->dstBinding = lb->binding;
+        entry->dstArrayElement = 0;
+        entry->descriptorCount = count;
+        entry->descriptorType = lb->descriptorType;
+        entry->offset = (size_t)offset;
+        entry->stride = size;
+
+        offset += (u64)count * size;
+    }
+
+    out->data_size = align_up(offset, out->data_alignment);
+}
+
+const VkDescriptorUpdateTemplateEntry *get_update_template_entry(const spirv_update_template *tmpl, u32 binding)
+{
+    assert(tmpl != nullptr);
+
+    for_array(entry, &tmpl->entries)
+        if (entry->dstBinding == binding)
+            return entry;
+
+    return nullptr;
+}
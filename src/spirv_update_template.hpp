@@ -0,0 +1,38 @@
+#pragma once
+
+#include "spirv_parser.hpp"
+
+// VkDescriptorUpdateTemplateEntry arrays for vkUpdateDescriptorSetWithTemplate.
+// the descriptors of a set are read from one packed host-side struct that
+// holds, for every used binding in binding order, an array of
+//   VkDescriptorImageInfo   samplers, images and input attachments
+//   VkDescriptorBufferInfo  uniform and storage buffers, dynamic or not
+//   VkBufferView            texel buffers
+//   handle                  acceleration structures
+// with one element per descriptor. elements are naturally aligned, so the
+// struct matches a C struct with one array member per binding.
+
+struct spirv_update_template
+{
+    // one entry per used binding, in binding order
+    array<VkDescriptorUpdateTemplateEntry> entries;
+
+    u64 data_size; // of the host-side struct, a multiple of data_alignment
+    u32 data_alignment;
+};
+
+void init(spirv_update_template *tmpl);
+void free(spirv_update_template *tmpl);
+
+// bytes of one descriptor of type in the host-side struct, 0 for types
+// that cannot be updated through a template.
+u32 get_descriptor_update_size(VkDescriptorType type);
+
+// fills out from the used bindings of dset. bindings with
+// VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT get
+// variable_descriptor_count descriptors, if it is not 0.
+// bindings of unknown types are left out.
+void get_update_template(const spirv_descriptor_set *dset, spirv_update_template *out, u32 variable_descriptor_count = 0);
+
+// the entry of binding, nullptr if the template has none.
+const VkDescriptorUpdateTemplateEntry *get_update_template_entry(const spirv_update_template *tmpl, u32 binding);